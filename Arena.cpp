@@ -0,0 +1,32 @@
+#include <Arduino.h>
+#include <stddef.h>
+#include "Arena.h"
+
+namespace Arena
+{
+  Layout ram;
+
+  void ReportPart(const char* name, size_t offset, size_t size)
+  {
+    Serial.print(name);
+    Serial.print(" @");
+    Serial.print((int)offset);
+    Serial.print(", ");
+    Serial.print((int)size);
+    Serial.println(" bytes");
+  }
+
+  void Report()
+  {
+    // where each part is, the sizes are all known at compile time
+    Serial.print("arena ");
+    Serial.print((int)sizeof(ram));
+    Serial.println(" bytes");
+    ReportPart("  rowBuffer", offsetof(Layout, rowBuffer), sizeof(ram.rowBuffer));
+#ifdef DISPLAY_SPI_ISR
+    ReportPart("  sendBuffer", offsetof(Layout, sendBuffer), sizeof(ram.sendBuffer));
+#endif
+    ReportPart("  strBuffer", offsetof(Layout, strBuffer), sizeof(ram.strBuffer));
+    ReportPart("  table    ", offsetof(Layout, table), sizeof(ram.table));
+  }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+// The RAM for drawing & sending the page, in one block laid out here, the sparse table gets what the rest leave
+// who uses what, by phase:
+//   sensor    (Weather::Loop)      none of it, the readings are kept in Weather
+//   layout    (Page)               strBuffer, the text being drawn, kept until its section is sent as it may be redrawn
+//   render    (SparseInk)          the table, from Clear until the band's rows are sent (and the red rows, to the end)
+//   transmit  (SparseInk::SendRows) rowBuffer, and the table, read only
+//   SPI interrupt                  sendBuffer, with DISPLAY_SPI_ISR, a copy of the last row, going out as the next is drawn
+// layout, render & transmit take turns band by band, so their parts are laid end to end, none can share
+#include "Display.h"
+#include "SparseInk.h"
+
+#ifndef ARENA_SIZE
+// 1082 bytes (the old 1000 byte table, the row & text buffers) less the 219 bytes of globals added since (the row
+// directory, redraw commands, inks...), so static RAM's no more than it was, the stack's margin isn't measured on a board.
+// the same on the Leonardo (2.5K, but USB CDC & Wire take their share), a bigger one waits on measuring its free stack
+#define ARENA_SIZE 863
+#endif
+#define ARENA_ROW_BUFFER_SIZE (DISPLAY_WIDTH/4) // a row of mono (2bpp) or red pixels
+#define ARENA_STR_BUFFER_SIZE 32
+#ifdef DISPLAY_SPI_ISR
+#define ARENA_SEND_BUFFER_SIZE ARENA_ROW_BUFFER_SIZE
+#else
+#define ARENA_SEND_BUFFER_SIZE 0
+#endif
+#define TABLE_SIZE (ARENA_SIZE - ARENA_ROW_BUFFER_SIZE - ARENA_SEND_BUFFER_SIZE - ARENA_STR_BUFFER_SIZE) // bytes
+
+namespace Arena
+{
+  struct Layout
+  {
+    byte rowBuffer[ARENA_ROW_BUFFER_SIZE];                   // Display
+#ifdef DISPLAY_SPI_ISR
+    byte sendBuffer[ARENA_SEND_BUFFER_SIZE];                 // Display
+#endif
+    char strBuffer[ARENA_STR_BUFFER_SIZE];                   // Page
+    SparseInk::Coord table[TABLE_SIZE/sizeof(SparseInk::Coord)]; // SparseInk
+  };
+  static_assert(TABLE_SIZE >= 500, "ARENA_SIZE leaves too little for the sparse table");
+
+  extern Layout ram;
+  void Report(); // print the layout over Serial
+};
@@ -28,6 +28,13 @@
 // If defined, add folded page corner
 #define FOLD_CORNER
 
+// If defined, the temperature & humidity line's rows are kept in the sparse table between pages, only the changed chars
+// are erased & drawn again. The kept rows take ~800 bytes of the table, so it needs an ARENA_SIZE of 2K (see Arena.h),
+// a bigger board than the Uno. With the Uno's (~870 bytes) the bench's pages overflow in 27 of 48 bands, sends take ~4x
+// as long and a row which won't fit beside the kept ones is sent short, so Page stops the build. With 2K nothing
+// overflows and the bench's page edits draw ~10% quicker
+//#define CONFIG_RETAIN_TH_LINE
+
 // If defined, display demo values, see Weather::Loop()
 //#define DEMO
 
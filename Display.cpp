@@ -3,11 +3,13 @@
 #include "Pins.h"
 #include "Config.h"
 #include "Display.h"
+#include "Arena.h"
 
 namespace Display {
 // Note that the Jaycar site
 //    https://www.jaycar.co.nz/duinotech-arduino-compatible-1-54-inch-monochrome-e-ink-display/p/XC3747
-// suggests partial updates are supported.  I'm, not so sure. In any case, this code only does full updates of the entires screeb.
+// suggests partial updates are supported.  I'm, not so sure. By default this code only does full updates of the entire screen,
+// DISPLAY_PARTIAL (see Display.h) sends & refreshes just the rows which changed, try it on the panel before relying on it.
 // Red is implemented but not used.
 // command values
 #define CMD_PANEL_SETTING                               0x00
@@ -22,25 +24,71 @@ namespace Display {
 #define CMD_VCOM_AND_DATA_INTERVAL_SETTING              0x50
 #define CMD_TCON_RESOLUTION                             0x61
 #define CMD_VCM_DC_SETTING_REGISTER                     0x82
+#define CMD_PARTIAL_WINDOW                              0x90
+#define CMD_PARTIAL_IN                                  0x91
+#define CMD_PARTIAL_OUT                                 0x92
 
 // forward's
-void SetLUTs();
+#ifdef DISPLAY_SERIALIZE
+void SerialiseRow(const byte* buff, size_t len);
+#endif
+void SendLUTs();
+void SetPower();
+void SetVcmDc();
+void Wake();
 void SendCommand(byte cmd);
 void SendData(byte data);
 void WaitUntilIdle();
-// a single buffer with space for a row of mono or red pixels
-byte rowBuffer[DISPLAY_WIDTH/4];
+void Finish();
+// a single buffer with space for a row of mono or red pixels, in the arena
+byte (&rowBuffer)[DISPLAY_WIDTH/4] = Arena::ram.rowBuffer;
 
 bool monoBufferMode = true;  // mono/red mode, set in StartMono()/StartColour(), not by colour setting
 
+// what the panel's doing in the background, moved on by Poll() once BUSY is released
+enum State {StateIdle, StateRefreshing, StatePoweringDown};
+State state = StateIdle;
+bool sleepNext = false; // BeginSleep() was called while refreshing
+bool redBlank = false;  // the panel's red plane is all ColourNone, from SendBlankRed() until StartRed() or Reset()
+// the controller has Init's settings & LUTs, from SendLUTs() until Reset(), the power off at the end of Sleep keeps them
+bool lutsLoaded = false;
+#ifdef DISPLAY_LUT_PROFILES
+LUTProfile lutProfile = LUTNormal; // the ones loaded
+LUTProfile lutNext = LUTNormal;    // SetLUTs', for Init
+#endif
+bool poweredOff = false; // by Sleep, until Init
+
 #ifdef DISPLAY_SERIALIZE
 // if defined, swithes it off or on
 bool _serialise = false;
 #endif
+#ifdef DISPLAY_STATS
+Stats stats;
+#define STAT(_stmt) _stmt
+#else
+#define STAT(_stmt)
+#endif
+
+#ifdef DISPLAY_PARTIAL
+// the rows sent are hashed, the mono plane's by band, to find the rows which changed, see StartHashing
+#define PARTIAL_BANDS ((DISPLAY_HEIGHT + PARTIAL_BAND_ROWS - 1)/PARTIAL_BAND_ROWS)
+uint16_t bandHash[PARTIAL_BANDS]; // of the last frame's mono rows, by band
+uint16_t redHash = 0;             // of its red plane, 0 if blank
+uint16_t hash = 0;                // the band (or red plane) so far
+bool hashing = false;             // nothing is sent, just hashed
+int changedFirst = 0, changedLast = -1; // the rows of the bands which changed, while hashing
+int sendRow = 0;                  // SendRowBuffer's, from StartMono/StartRed
+int windowFirst = 0, windowLast = DISPLAY_HEIGHT - 1; // the rows sent, see StartWindow
+bool partial = false;             // the panel's in partial mode, until the refresh is done
+#define PARTIAL(_stmt) _stmt
+#else
+#define PARTIAL(_stmt)
+#endif
 
 void Init()
 {
-  // initialise the display, buffer etc
+  // initialise the display, buffer etc, after any refresh or sleep under way
+  Finish();
   ::memset(rowBuffer, 0, sizeof(rowBuffer));
   pinMode(PIN_DISPLAY_CS,   OUTPUT);
   pinMode(PIN_DISPLAY_RST,  OUTPUT);
@@ -48,14 +96,23 @@ void Init()
   pinMode(PIN_DISPLAY_BUSY, INPUT); 
   SPI.begin();
   SPI.beginTransaction(SPISettings(2000000, MSBFIRST, SPI_MODE0));
+#ifndef DISPLAY_COLD_WAKE
+  if (poweredOff && lutsLoaded)
+  {
+    // warm, it's just powered off, no reset
+    Wake();
+#ifdef DISPLAY_LUT_PROFILES
+    if (lutNext != lutProfile)
+      SendLUTs();
+#endif
+    return;
+  }
+#endif
+  poweredOff = false;
   
   // hardware init
   Reset();
-  SendCommand(CMD_POWER_SETTING);
-  SendData(0x07);
-  SendData(0x00);
-  SendData(0x08);
-  SendData(0x00);
+  SetPower();
   SendCommand(CMD_BOOSTER_SOFT_START);
   SendData(0x07);
   SendData(0x07);
@@ -74,41 +131,215 @@ void Init()
   SendData(0xC8);
   SendData(0x00);
   SendData(0xC8);
+  SetVcmDc();
+  
+  SendLUTs();
+}
+
+void SetPower()
+{
+  SendCommand(CMD_POWER_SETTING);
+  SendData(0x07);
+  SendData(0x00);
+  SendData(0x08);
+  SendData(0x00);
+}
+
+void SetVcmDc()
+{
   SendCommand(CMD_VCM_DC_SETTING_REGISTER);
   SendData(0x0E);
-  
-  SetLUTs();
+}
+
+void Wake()
+{
+  // out of Sleep's power off, the controller kept its registers, LUTs & RAM, just put back what StartSleep changed & power on
+  poweredOff = false;
+  SetPower();
+  SetVcmDc();
+  SendCommand(CMD_POWER_ON);
+  WaitUntilIdle();
 }
 
 void Reset()
 {
   // wake
-  digitalWrite(PIN_DISPLAY_RST, LOW); 
+  Pin<PIN_DISPLAY_RST>::Low();
   delay(200);
-  digitalWrite(PIN_DISPLAY_RST, HIGH);
+  Pin<PIN_DISPLAY_RST>::High();
   delay(200);      
+  redBlank = false; // its RAM may not survive
+  lutsLoaded = false;
+  PARTIAL(partial = false; windowFirst = 0; windowLast = DISPLAY_HEIGHT - 1);
 }
 
+#ifdef DISPLAY_SPI_ISR
+// the row going out, a byte per SPI interrupt (see the end), while the next is drawn in rowBuffer
+byte (&sendBuffer)[DISPLAY_WIDTH/4] = Arena::ram.sendBuffer;
+static_assert(sizeof(sendBuffer) < 256, "the send position is a byte");
+volatile bool sending = false;
+volatile byte sendPos = 0;
+byte sendLen = 0;
+
+void Drain()
+{
+  // wait for the row going out, then SPI can be used directly again
+#ifdef __AVR__
+  while (sending)
+    ;
+#else
+  // a PC build has no interrupt, the row goes now
+  if (!sending)
+    return;
+  while (sendPos < sendLen)
+    SPI.transfer(sendBuffer[sendPos++]);
+  Pin<PIN_DISPLAY_CS>::High();
+  sending = false;
+#endif
+}
+
+void QueueRow(const byte* buff, byte len)
+{
+  // start the row going out, once the last one has, it's copied so the caller can carry on with buff
+  Drain();
+  ::memcpy(sendBuffer, buff, len);
+  sendLen = len;
+  sendPos = 1;
+  sending = true;
+  Pin<PIN_DISPLAY_DC>::High();
+  Pin<PIN_DISPLAY_CS>::Low();
+#ifdef __AVR__
+  SPCR |= _BV(SPIE);
+  SPDR = sendBuffer[0];
+#else
+  SPI.transfer(sendBuffer[0]);
+#endif
+  STAT(stats.bytes += len; stats.selects++);
+}
+#else
+void Drain()
+{
+}
+#endif
+
 void SendCommand(byte cmd)
 {
-  digitalWrite(PIN_DISPLAY_DC, LOW);
-  digitalWrite(PIN_DISPLAY_CS, LOW);
+  PARTIAL(if (hashing) return);
+  Drain();
+  Pin<PIN_DISPLAY_DC>::Low();
+  Pin<PIN_DISPLAY_CS>::Low();
   SPI.transfer(cmd);
-  digitalWrite(PIN_DISPLAY_CS, HIGH);
+  Pin<PIN_DISPLAY_CS>::High();
+  STAT(stats.bytes++; stats.selects++);
 }
 
 void SendData(byte data)
 {
-  digitalWrite(PIN_DISPLAY_DC, HIGH);
-  digitalWrite(PIN_DISPLAY_CS, LOW);
+  PARTIAL(if (hashing) return);
+  Drain();
+  Pin<PIN_DISPLAY_DC>::High();
+  Pin<PIN_DISPLAY_CS>::Low();
   SPI.transfer(data);
-  digitalWrite(PIN_DISPLAY_CS, HIGH);
+  Pin<PIN_DISPLAY_CS>::High();
+  STAT(stats.bytes++; stats.selects++);
 }
 
+void SendData(const byte* data, size_t len)
+{
+  // the pins are set once, then the bytes go back to back, each as soon as the last has shifted out
+  // (SPI.transfer's buffer version would overwrite data with what comes back)
+  PARTIAL(if (hashing) return);
+  Drain();
+  Pin<PIN_DISPLAY_DC>::High();
+  Pin<PIN_DISPLAY_CS>::Low();
+  for (size_t i = 0; i < len; i++)
+    SPI.transfer(data[i]);
+  Pin<PIN_DISPLAY_CS>::High();
+  STAT(stats.bytes += len; stats.selects++);
+}
+
+#ifdef DISPLAY_PARTIAL
+void Changed(int firstRow, int lastRow)
+{
+  // note rows which differ from the last frame
+  changedFirst = min(changedFirst, firstRow);
+  changedLast = max(changedLast, lastRow);
+}
+
+uint16_t Crc(uint16_t crc, byte data)
+{
+  // CRC-CCITT, a byte at a time, no table (as avr-libc's _crc_ccitt_update)
+  data ^= crc & 0xFF;
+  data ^= data << 4;
+  return (((uint16_t)data << 8) | (crc >> 8)) ^ (byte)(data >> 4) ^ ((uint16_t)data << 3);
+}
+
+void HashRow(const byte* buff, size_t len)
+{
+  // add the row to its band's hash (or the red plane's), and when that's done, note if it changed
+  if (!(monoBufferMode ? sendRow % PARTIAL_BAND_ROWS : sendRow))
+    hash = 0xFFFF;
+  for (size_t i = 0; i < len; i++)
+    hash = Crc(hash, buff[i]);
+  if (!monoBufferMode)
+  {
+    if (sendRow == DISPLAY_HEIGHT - 1)
+    {
+      if (hash != redHash)
+        Changed(0, DISPLAY_HEIGHT - 1);
+      redHash = hash;
+    }
+  }
+  else if (sendRow % PARTIAL_BAND_ROWS == PARTIAL_BAND_ROWS - 1 || sendRow == DISPLAY_HEIGHT - 1)
+  {
+    int band = sendRow/PARTIAL_BAND_ROWS;
+    if (hash != bandHash[band])
+      Changed(band*PARTIAL_BAND_ROWS, sendRow);
+    bandHash[band] = hash;
+  }
+}
+
+void StartHashing()
+{
+  // until EndHashing, a frame's rows are only hashed, nothing is sent
+  hashing = true;
+  changedFirst = DISPLAY_HEIGHT;
+  changedLast = -1;
+}
+
+bool EndHashing(int& firstRow, int& lastRow)
+{
+  // the rows of the bands which changed, from the last frame to the one just hashed
+  hashing = false;
+  firstRow = changedFirst;
+  lastRow = changedLast;
+  return firstRow <= lastRow;
+}
+
+void StartWindow(int firstRow, int lastRow)
+{
+  // the next frame's just these rows, the whole width, sent & refreshed, the rest of the panel is left alone
+  windowFirst = firstRow;
+  windowLast = lastRow;
+  partial = true;
+  SendCommand(CMD_PARTIAL_IN);
+  SendCommand(CMD_PARTIAL_WINDOW);
+  SendData(0);                           // from col 0
+  SendData((DISPLAY_WIDTH - 1) | 0x07);  // to the last, the low 3 bits are ignored
+  SendData(firstRow >> 8);
+  SendData(firstRow & 0xFF);
+  SendData(lastRow >> 8);
+  SendData(lastRow & 0xFF);
+  SendData(0x01);                        // gates scan both inside & outside the window
+}
+#endif
+
 void StartMono()
 {
-  // start updating the mono buffer
+  // start updating the mono buffer, once any refresh is done
+  Finish();
   monoBufferMode = true;
+  PARTIAL(sendRow = 0);
   delay(2);
   SendCommand(CMD_DATA_START_TRANSMISSION_1);
   delay(2);
@@ -116,31 +347,61 @@ void StartMono()
 
 void StartRed()
 {
-  // start updating the red buffer
+  // start updating the red buffer, once any refresh is done
+  Finish();
   monoBufferMode = false;
+  PARTIAL(sendRow = 0);
+  redBlank = false;
   delay(2);
   SendCommand(CMD_DATA_START_TRANSMISSION_2);
   delay(2);   
 }
 
-void WaitUntilIdle()
+void SendBlankRed()
 {
-  // wait until busy goes high
-  while (!digitalRead(PIN_DISPLAY_BUSY))
-    delay(100);
+  // the whole red plane as ColourNone, the same byte over & over, no row buffer
+  // or nothing, if the panel still has the last one (it keeps its RAM through a refresh)
+#ifdef DISPLAY_PARTIAL
+  if (redHash)
+    Changed(0, DISPLAY_HEIGHT - 1);
+  redHash = 0;
+  if (hashing)
+    return;
+  size_t rows = windowLast - windowFirst + 1;
+#else
+  size_t rows = DISPLAY_HEIGHT;
+#endif
+#ifdef DISPLAY_SERIALIZE
+  if (_serialise)
+  {
+    // row by row, for convert.py, every frame, even when the panel has them
+    FillRowBuffer(ColourNone);
+    for (int row = 0; row < DISPLAY_HEIGHT; row++)
+      SerialiseRow(rowBuffer, DISPLAY_WIDTH/8);
+  }
+#endif
+  if (redBlank)
+    return;
+  StartRed();
+  Pin<PIN_DISPLAY_DC>::High();
+  Pin<PIN_DISPLAY_CS>::Low();
+  for (size_t i = 0; i < rows*(DISPLAY_WIDTH/8); i++)
+    SPI.transfer(0xFF);
+  Pin<PIN_DISPLAY_CS>::High();
+  STAT(stats.bytes += (unsigned long)rows*(DISPLAY_WIDTH/8); stats.selects++);
+  redBlank = true;
 }
 
-void Refresh()
+void WaitUntilIdle()
 {
-  // update the display from the buffers
-  delay(2);
-  SendCommand(CMD_DISPLAY_REFRESH);
-  WaitUntilIdle();  
+  // wait until busy goes high
+  while (!Pin<PIN_DISPLAY_BUSY>::Read())
+    delay(100);
 }
 
-void Sleep()
+void StartSleep()
 {
-  // enter deep sleep, call Init to rewake
+  // the first half of going to sleep, Poll sends the power off when it's done
   SendCommand(CMD_VCOM_AND_DATA_INTERVAL_SETTING);
   SendData(0x17);
   SendCommand(CMD_VCM_DC_SETTING_REGISTER);  // to solve Vcom drop
@@ -150,8 +411,88 @@ void Sleep()
   SendData(0x00);
   SendData(0x00);
   SendData(0x00);
-  WaitUntilIdle();
-  SendCommand(CMD_POWER_OFF);  // power off
+  state = StatePoweringDown;
+}
+
+bool Poll()
+{
+  // move on from a refresh or sleep once the panel's released BUSY, returns true when there's nothing under way
+  if (state != StateIdle && Pin<PIN_DISPLAY_BUSY>::Read())
+  {
+    if (state == StatePoweringDown)
+    {
+      SendCommand(CMD_POWER_OFF);  // power off
+      poweredOff = true;
+      state = StateIdle;
+      return true;
+    }
+#ifdef DISPLAY_PARTIAL
+    if (partial)
+    {
+      // the window's refreshed, back to whole frames
+      SendCommand(CMD_PARTIAL_OUT);
+      partial = false;
+      windowFirst = 0;
+      windowLast = DISPLAY_HEIGHT - 1;
+    }
+#endif
+    if (sleepNext)
+    {
+      sleepNext = false;
+      StartSleep();
+    }
+    else
+      state = StateIdle;
+  }
+  return state == StateIdle;
+}
+
+bool IsIdle()
+{
+  return state == StateIdle;
+}
+
+void Finish()
+{
+  // wait for the refresh or sleep under way
+  while (!Poll())
+    delay(100);
+}
+
+void BeginRefresh()
+{
+  // update the display from the buffers, in the background, see Poll
+  PARTIAL(if (hashing) return);
+  Finish();
+  delay(2);
+  SendCommand(CMD_DISPLAY_REFRESH);
+  state = StateRefreshing;
+}
+
+void Refresh()
+{
+  // update the display from the buffers, and wait for it
+  BeginRefresh();
+  Finish();
+}
+
+void BeginSleep()
+{
+  // enter deep sleep when any refresh is done, in the background, see Poll. call Init to rewake
+  if (state == StateRefreshing)
+    sleepNext = true;
+  else
+  {
+    Finish();
+    StartSleep();
+  }
+}
+
+void Sleep()
+{
+  // enter deep sleep, and wait for it, call Init to rewake
+  BeginSleep();
+  Finish();
 }
 
 static const byte pLUTData[] PROGMEM =
@@ -187,30 +528,84 @@ static const byte pLUTData[] PROGMEM =
   0x00
 };
 
-void SetLUTs()
+#ifdef DISPLAY_LUT_PROFILES
+// each profile's LUTs are pLUTData's with the repeat counts of their phases scaled, in 1/8ths, mono & red
+static const byte pLUTRepeats[][2] PROGMEM =
+{
+  {16, 16}, // LUTFreezing, below 0C the particles are slow
+  {12, 12}, // LUTCold, below 10C
+  { 8,  8}, // LUTNormal, the panel's own
+  { 6,  6}, // LUTHot, 30C & up
+  { 4,  4}, // LUTFast
+};
+#define LUT_GROUP 3 // bytes, 2 phases (level in the top 2 bits, frames in the rest), then the group's repeat count
+
+LUTProfile ChooseLUTs(int temperature_C, bool smallChange, int fastSinceFull)
+{
+  // the temperature's band, or LUTFast for a small change in the normal range, if a full one's not due
+  if (temperature_C < 0)
+    return LUTFreezing;
+  if (temperature_C < 10)
+    return LUTCold;
+  if (temperature_C >= 30)
+    return LUTHot;
+  if (smallChange && fastSinceFull < LUT_FULL_EVERY - 1)
+    return LUTFast;
+  return LUTNormal;
+}
+
+void SetLUTs(LUTProfile profile)
+{
+  lutNext = profile;
+}
+#endif
+
+void SendLUTs()
 {
   // set look-up tables
   const byte* pLUT = pLUTData;
-  while (pgm_read_byte_near(pLUT))
+  byte lut[15];
+  while (byte cmd = pgm_read_byte_near(pLUT++))
   {
-    SendCommand(pgm_read_byte_near(pLUT++));
-    for (int i = 0; i < 15; i++)
-      SendData(pgm_read_byte_near(pLUT++));
+    SendCommand(cmd);
+    memcpy_P(lut, pLUT, sizeof(lut));
+    pLUT += sizeof(lut);
+#ifdef DISPLAY_LUT_PROFILES
+    byte scale = pgm_read_byte_near(&pLUTRepeats[lutNext][cmd >= 0x25]); // red from lut_vcom1
+    for (byte i = LUT_GROUP - 1; i < sizeof(lut); i += LUT_GROUP)
+      if (lut[i])
+        lut[i] = max((lut[i]*scale + 4)/8, 1);
+#endif
+    SendData(lut, sizeof(lut));
   }
+  lutsLoaded = true;
+#ifdef DISPLAY_LUT_PROFILES
+  lutProfile = lutNext;
+#endif
 }
 
-void FillRowBuffer(byte* buff, Colour clr)
+byte FillByte(Colour clr)
 {
-  // set all pixels in the row buffer
-  byte val = 0b00000000;
+  // a byte of pixels in the colour, 2 bpp mono or 1 bpp red
   switch (clr)
   {
-    case MonoGrey   : val = 0b10101010; break;
-    case MonoWhite  : val = 0b11111111; break;
-    case ColourNone : val = 0b11111111; break;
-    default         : val = 0b00000000; break;
+    case MonoGrey   : return 0b10101010;
+    case MonoWhite  : return 0b11111111;
+    case ColourNone : return 0b11111111;
+    default         : return 0b00000000;
   }
-  ::memset(buff, val, DISPLAY_WIDTH/4);  
+}
+
+void SetRowBufferByte(byte* ptr, byte mask, byte val)
+{
+  // set the bits of *ptr in mask from val
+  *ptr = (*ptr & ~mask) | (val & mask);
+}
+
+void FillRowBuffer(byte* buff, Colour clr)
+{
+  // set all pixels in the row buffer
+  ::memset(buff, FillByte(clr), DISPLAY_WIDTH/4);  
 }    
 
 void SetRowBufferAt(byte* buff, int col, Colour clr)
@@ -242,8 +637,81 @@ void SetRowBufferAt(byte* buff, int col, Colour clr)
 void SetRowBufferAt(byte* buff, int col, Colour clr, int len)
 {
   // set a series of pixel in the row buffer
-  while (len--)
-    SetRowBufferAt(buff, col++, clr);
+  // whole bytes at a time, masking the partial bytes at either end
+  if (len <= 0)
+    return;
+  byte val = FillByte(clr);
+  byte shift = (clr < ColourNone) ? 2 : 3; // pixels per byte is 1 << shift
+  byte bpp = 8 >> shift;
+  byte pixelMask = (1 << shift) - 1;
+  int last = col + len;
+  byte* ptr = buff + (col >> shift);
+  byte* end = buff + (last >> shift);
+  byte headMask = 0xFF >> (bpp*(col & pixelMask));
+  byte tailMask = ~(0xFF >> (bpp*(last & pixelMask)));
+  if (ptr == end)
+  {
+    SetRowBufferByte(ptr, headMask & tailMask, val);
+    return;
+  }
+  SetRowBufferByte(ptr++, headMask, val);
+  ::memset(ptr, val, end - ptr);
+  if (tailMask)
+    SetRowBufferByte(end, tailMask, val);
+}
+
+// each bit of a 1 bpp byte as 2 bits, MSB first
+const uint16_t pMask2bpp[256] PROGMEM = {
+  0x0000, 0x0003, 0x000C, 0x000F, 0x0030, 0x0033, 0x003C, 0x003F,
+  0x00C0, 0x00C3, 0x00CC, 0x00CF, 0x00F0, 0x00F3, 0x00FC, 0x00FF,
+  0x0300, 0x0303, 0x030C, 0x030F, 0x0330, 0x0333, 0x033C, 0x033F,
+  0x03C0, 0x03C3, 0x03CC, 0x03CF, 0x03F0, 0x03F3, 0x03FC, 0x03FF,
+  0x0C00, 0x0C03, 0x0C0C, 0x0C0F, 0x0C30, 0x0C33, 0x0C3C, 0x0C3F,
+  0x0CC0, 0x0CC3, 0x0CCC, 0x0CCF, 0x0CF0, 0x0CF3, 0x0CFC, 0x0CFF,
+  0x0F00, 0x0F03, 0x0F0C, 0x0F0F, 0x0F30, 0x0F33, 0x0F3C, 0x0F3F,
+  0x0FC0, 0x0FC3, 0x0FCC, 0x0FCF, 0x0FF0, 0x0FF3, 0x0FFC, 0x0FFF,
+  0x3000, 0x3003, 0x300C, 0x300F, 0x3030, 0x3033, 0x303C, 0x303F,
+  0x30C0, 0x30C3, 0x30CC, 0x30CF, 0x30F0, 0x30F3, 0x30FC, 0x30FF,
+  0x3300, 0x3303, 0x330C, 0x330F, 0x3330, 0x3333, 0x333C, 0x333F,
+  0x33C0, 0x33C3, 0x33CC, 0x33CF, 0x33F0, 0x33F3, 0x33FC, 0x33FF,
+  0x3C00, 0x3C03, 0x3C0C, 0x3C0F, 0x3C30, 0x3C33, 0x3C3C, 0x3C3F,
+  0x3CC0, 0x3CC3, 0x3CCC, 0x3CCF, 0x3CF0, 0x3CF3, 0x3CFC, 0x3CFF,
+  0x3F00, 0x3F03, 0x3F0C, 0x3F0F, 0x3F30, 0x3F33, 0x3F3C, 0x3F3F,
+  0x3FC0, 0x3FC3, 0x3FCC, 0x3FCF, 0x3FF0, 0x3FF3, 0x3FFC, 0x3FFF,
+  0xC000, 0xC003, 0xC00C, 0xC00F, 0xC030, 0xC033, 0xC03C, 0xC03F,
+  0xC0C0, 0xC0C3, 0xC0CC, 0xC0CF, 0xC0F0, 0xC0F3, 0xC0FC, 0xC0FF,
+  0xC300, 0xC303, 0xC30C, 0xC30F, 0xC330, 0xC333, 0xC33C, 0xC33F,
+  0xC3C0, 0xC3C3, 0xC3CC, 0xC3CF, 0xC3F0, 0xC3F3, 0xC3FC, 0xC3FF,
+  0xCC00, 0xCC03, 0xCC0C, 0xCC0F, 0xCC30, 0xCC33, 0xCC3C, 0xCC3F,
+  0xCCC0, 0xCCC3, 0xCCCC, 0xCCCF, 0xCCF0, 0xCCF3, 0xCCFC, 0xCCFF,
+  0xCF00, 0xCF03, 0xCF0C, 0xCF0F, 0xCF30, 0xCF33, 0xCF3C, 0xCF3F,
+  0xCFC0, 0xCFC3, 0xCFCC, 0xCFCF, 0xCFF0, 0xCFF3, 0xCFFC, 0xCFFF,
+  0xF000, 0xF003, 0xF00C, 0xF00F, 0xF030, 0xF033, 0xF03C, 0xF03F,
+  0xF0C0, 0xF0C3, 0xF0CC, 0xF0CF, 0xF0F0, 0xF0F3, 0xF0FC, 0xF0FF,
+  0xF300, 0xF303, 0xF30C, 0xF30F, 0xF330, 0xF333, 0xF33C, 0xF33F,
+  0xF3C0, 0xF3C3, 0xF3CC, 0xF3CF, 0xF3F0, 0xF3F3, 0xF3FC, 0xF3FF,
+  0xFC00, 0xFC03, 0xFC0C, 0xFC0F, 0xFC30, 0xFC33, 0xFC3C, 0xFC3F,
+  0xFCC0, 0xFCC3, 0xFCCC, 0xFCCF, 0xFCF0, 0xFCF3, 0xFCFC, 0xFCFF,
+  0xFF00, 0xFF03, 0xFF0C, 0xFF0F, 0xFF30, 0xFF33, 0xFF3C, 0xFF3F,
+  0xFFC0, 0xFFC3, 0xFFCC, 0xFFCF, 0xFFF0, 0xFFF3, 0xFFFC, 0xFFFF,
+};
+
+void SetRowBufferBits(byte* buff, int col, byte bits, Colour clr)
+{
+  // set the pixels from col (a multiple of 8) whose bit is set, MSB first
+  byte val = FillByte(clr);
+  if (clr < ColourNone)
+  {
+    // 2 bpp
+    uint16_t mask = pgm_read_word_near(pMask2bpp + bits);
+    buff += col >> 2;
+    if (mask >> 8)
+      SetRowBufferByte(buff, mask >> 8, val);
+    if (mask & 0xFF)
+      SetRowBufferByte(buff + 1, mask & 0xFF, val);
+  }
+  else
+    SetRowBufferByte(buff + (col >> 3), bits, val);
 }
 
 int rowBufferWriteCol = 0;
@@ -267,35 +735,41 @@ void WriteRowBuffer(Colour clr, int len /*= 1*/)
   rowBufferWriteCol += len;
 }
 
-void SendRowByte(byte b)
-{
-  // wrapper to send the data byte to the display and optionally out the serial port
-  SendData(b);
-#ifdef DISPLAY_SERIALIZE
-  if (_serialise)
-  {
-    Serial.print((int)(b >> 4), HEX);
-    Serial.print((int)(b & 0x0F), HEX);
-  }
-#endif   
-}
-
 void SendRowBuffer(byte* buff)
 {
-  // send the entire row of pixels to the display
-  byte* pBuffer = buff;
-  if (monoBufferMode)
-    for (size_t i = 0; i < DISPLAY_WIDTH/4; i++)
-      SendRowByte(*pBuffer++);
-  else
-    for (size_t i = 0; i < DISPLAY_WIDTH/8; i++)
-      SendRowByte(*pBuffer++);
+  // send the entire row of pixels to the display, in one go, and optionally out the serial port
+  size_t len = monoBufferMode ? DISPLAY_WIDTH/4 : DISPLAY_WIDTH/8;
+#ifdef DISPLAY_PARTIAL
+  HashRow(buff, len);
+  bool inWindow = windowFirst <= sendRow && sendRow <= windowLast;
+  sendRow++;
+  if (hashing || !inWindow)
+    return;
+#endif
+#ifdef DISPLAY_SPI_ISR
+  QueueRow(buff, len); // goes out while the next is drawn
+#else
+  SendData(buff, len);
+#endif
 #ifdef DISPLAY_SERIALIZE  
   if (_serialise)
-    Serial.println();
+    SerialiseRow(buff, len);
 #endif        
 }
 
+#ifdef DISPLAY_SERIALIZE
+void SerialiseRow(const byte* buff, size_t len)
+{
+  // the row in hex, a line of its own, see convert.py
+  for (size_t i = 0; i < len; i++)
+  {
+    Serial.print((int)(buff[i] >> 4), HEX);
+    Serial.print((int)(buff[i] & 0x0F), HEX);
+  }
+  Serial.println();
+}
+#endif
+
 // these use the global rowBuffer
 void FillRowBuffer(Colour clr)
 {
@@ -311,6 +785,10 @@ void SetRowBufferAt(int col, Colour clr, int len)
 {
   SetRowBufferAt(rowBuffer, col, clr, len);
 }
+void SetRowBufferBits(int col, byte bits, Colour clr)
+{
+  SetRowBufferBits(rowBuffer, col, bits, clr);
+}
 
 Colour GetRowBufferAt(int col)
 {
@@ -347,3 +825,19 @@ void SendRowBuffer()
   SendRowBuffer(rowBuffer);
 }
 }
+
+#if defined(DISPLAY_SPI_ISR) && defined(__AVR__)
+ISR(SPI_STC_vect)
+{
+  // the last byte's gone, the next, or the end of the row
+  using namespace Display;
+  if (sendPos < sendLen)
+    SPDR = sendBuffer[sendPos++];
+  else
+  {
+    Pin<PIN_DISPLAY_CS>::High();
+    SPCR &= ~_BV(SPIE);
+    sending = false;
+  }
+}
+#endif
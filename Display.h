@@ -10,26 +10,71 @@
 #define SERIALISE_ON(_on) 
 #endif
 
+// optionally count the bytes sent & the chip selects they took:
+//#define DISPLAY_STATS
+
+// optionally refresh just the rows which changed since the last frame, see StartHashing:
+//#define DISPLAY_PARTIAL
+
+// optionally wake the panel from Sleep with a reset & the whole of Init, rather than just powering it back on:
+//#define DISPLAY_COLD_WAKE
+
+// optionally send each row from the SPI interrupt, out of a second row buffer (in the arena, so a smaller table), while
+// the next row is drawn. a PC build sends the row when the next is queued
+//#define DISPLAY_SPI_ISR
+
+// optionally refresh with LUTs for the temperature & how much changed, rather than always the panel's own, see ChooseLUTs.
+// they're the panel's own rescaled, not yet tried on a panel
+//#define DISPLAY_LUT_PROFILES
+
+#ifndef DISPLAY_WIDTH // the panel's, a PC build can try others
 #define DISPLAY_WIDTH  200
 #define DISPLAY_HEIGHT 200
+#endif
 namespace Display
 {
   enum Colour {MonoBlack, MonoGrey, MonoWhite, // 2 bpp
                ColourNone, ColourRed};         // 1 bpp, off = red
   
-  void Init();
+  void Init(); // after Sleep, just powers it back on, it keeps its settings & LUTs
   void Reset();
   void Sleep();
   void SendCommand(byte data);
   void SendData(byte data);
+  void SendData(const byte* data, size_t len); // back to back, one chip select
   void StartMono();
   void StartRed();
+  void SendBlankRed(); // all ColourNone, after StartMono's rows, instead of StartRed & rows
+#ifdef DISPLAY_LUT_PROFILES
+  // the LUTs (the refresh's waveforms), the panel's own (LUTNormal) lengthened for the cold & shortened for the heat, or a
+  // shorter one (LUTFast, ~60%) for small changes, it ghosts, so it's replaced by a full one every LUT_FULL_EVERY pages
+  enum LUTProfile {LUTFreezing, LUTCold, LUTNormal, LUTHot, LUTFast};
+#define LUT_FULL_EVERY 8
+  LUTProfile ChooseLUTs(int temperature_C, bool smallChange, int fastSinceFull); // just the policy, see bench
+  void SetLUTs(LUTProfile profile); // before Init, which sends them, if they're not the ones already loaded
+#endif
+#ifdef DISPLAY_PARTIAL
+  // a frame drawn between StartHashing & EndHashing isn't sent, its rows are hashed, in bands, against the last frame's.
+  // EndHashing gives the rows of the bands which changed (false if none), StartWindow (after Init) then makes the next
+  // frame just those rows, its refresh too, the rows outside are skipped as they're sent
+#define PARTIAL_BAND_ROWS 8
+  void StartHashing();
+  bool EndHashing(int& firstRow, int& lastRow);
+  void StartWindow(int firstRow, int lastRow);
+#endif
   void Refresh();
+  // Refresh & Sleep without waiting for the panel, which is busy for seconds. Poll moves them on, call it until it (or
+  // IsIdle) returns true. Init, StartMono, StartRed & the blocking versions wait for whatever's under way first
+  void BeginRefresh();
+  void BeginSleep(); // after the refresh, if there's one
+  bool Poll();
+  bool IsIdle();
   
-  extern byte rowBuffer[DISPLAY_WIDTH/4];  // a single buffer with space for a row of mono or red pixels
+  extern byte (&rowBuffer)[DISPLAY_WIDTH/4];  // a single buffer with space for a row of mono or red pixels
   void FillRowBuffer(Colour clr);
   void SetRowBufferAt(int col, Colour clr);
   void SetRowBufferAt(int col, Colour clr, int len);
+  void SetRowBufferBits(int col, byte bits, Colour clr); // the 8 pixels from col (a multiple of 8) with a bit set, MSB first
   Colour GetRowBufferAt(int col);
 
   // writing pixels at a cursor pos, auto-advances
@@ -38,12 +83,22 @@ namespace Display
   void WriteRowBuffer(Colour clr, int len = 1);
   
   void SendRowBuffer();
+  void Drain(); // wait for the rows sent to go out, only needed to share SPI (the Send* & Start* functions do)
   
   void FillRowBuffer(byte* buff, Colour clr);
   void SetRowBufferAt(byte* buff, int col, Colour clr);
   void SetRowBufferAt(byte* buff, int col, Colour clr, int len);
+  void SetRowBufferBits(byte* buff, int col, byte bits, Colour clr);
   
   void SendRowBuffer(byte* buff);
 
   extern bool _serialise;
+#ifdef DISPLAY_STATS
+  struct Stats
+  {
+    unsigned long bytes;   // commands & data
+    unsigned long selects; // CS asserted
+  };
+  extern Stats stats;
+#endif
 };
@@ -66,8 +66,7 @@ namespace Graphics
           y0++;
         }
         offs &= 0x7F;
-        for (int p = 0; p < w; p++)
-          SparseInk::Pixel(y0, x0 + offs + p);
+        SparseInk::Span(y0, x0 + offs, w);
       }
     } while (w);
   }
@@ -6,76 +6,236 @@
 #include "StrokedFont.h"
 #include "SparseInk.h"
 #include "Weather.h"
+#include "Arena.h"
 #include "Page.h"
 
 namespace Page
 {
 #define ITOA(_value, _buffer) ::itoa((_value), (_buffer), 10)
 
-  // pure grey is very faint! -- dither instead, alternate pixels are non-black
-#ifdef DITHER_UNITS  
-  bool ditherText = true;
-#else
-  bool ditherText = false;
-#endif  
-  bool ditherForecast = false;
-  Display::Colour ditherAltColour = Display::MonoGrey;
-  
-#define NUM_RULE_BLOCKS 2
-  byte ruleData[2*NUM_RULE_BLOCKS] = {0xFF, 0xFF, 0xFF, 0xFF}; // start/end cols
-  void RuleFunc(int row)
+  // pure grey is very faint! -- dithered inks instead, alternate pixels are lighter
+  // Text draws the chars in textInkChars (bit i for strBuffer[i]) in textInk, the rest in black
+  SparseInk::Ink textInk = SparseInk::InkDither;
+  uint32_t textInkChars = 0;
+  SparseInk::Ink iconInk = SparseInk::InkBlack;
+  bool foldCorner = false;
+
+#define NO_SECTION ((SparseInk::Coord)~0)
+  SparseInk::Coord sectionStart = NO_SECTION; // the first row in an updated section
+  SparseInk::Coord sectionEnd = 0;            // and the last, once it's known
+  Display::Colour foreground = Display::MonoBlack;
+  Display::Colour background = Display::MonoWhite;
+  char (&strBuffer)[ARENA_STR_BUFFER_SIZE] = Arena::ram.strBuffer;
+
+  // the drawing done in the current section, kept so it can be redrawn in pieces if it doesn't fit in SparseInk
+  enum DrawKind {eText, eIcon, eChar, eCounter};
+  // all but inkChars on the panel & small, so bytes, 11 per command (13 on a panel over 255 pixels)
+  struct DrawCommand
   {
-    // rule-based colouration (etc), called by SparseInk just before row buffer is sent
-    if (ditherText || ditherForecast)
-      // lighten alternate pixels
-      for (int band = 0; band < NUM_RULE_BLOCKS; band++)
-        for (int col = ruleData[2*band]; col <= ruleData[2*band+1]; col++)
+    byte kind;
+    byte ink; // a SparseInk::Ink
+    SparseInk::Coord x, y;
+    byte a, b; // scale for text, index for an icon, the char or counter value
+    int8_t c;  // gap for text
+    uint32_t inkChars; // for text, the chars in ink
+  };
+#define MAX_DRAW_COMMANDS 8
+  DrawCommand drawCommands[MAX_DRAW_COMMANDS];
+  int numDrawCommands = 0; // if more than MAX_DRAW_COMMANDS, the section can't be redrawn
+
+#ifdef CONFIG_RETAIN_TH_LINE
+#if ARENA_SIZE < 2048
+#error "CONFIG_RETAIN_TH_LINE needs an ARENA_SIZE of 2K, see Config.h"
+#endif
+  // the temperature & humidity line's section is retained in SparseInk from one page to the next (if it was sent in one go)
+  // if the next line is the same but for a few chars, just those are erased & drawn again
+  struct RetainedLine
+  {
+    bool valid;
+    SparseInk::Coord sectionStart, sectionEnd;
+    int x, y;
+    uint32_t inkChars;
+    char text[16];
+  };
+  RetainedLine retainedLine = {};
+  bool retainSection = false; // set while the line's section is drawn, see SendRows
+#endif
+
+  void Draw(const DrawCommand& cmd)
+  {
+    switch (cmd.kind)
+    {
+      case eText:
+        // always from strBuffer
+        if (!cmd.inkChars)
+          StrokedFont::DrawText(cmd.x, cmd.y, strBuffer, cmd.a, cmd.b, cmd.c);
+        else
         {
-          if (Display::GetRowBufferAt(col) == Display::MonoBlack && (col % 2) != (row % 2))
-            Display::SetRowBufferAt(col, ditherAltColour);
+          // in pieces, each a run of chars with the same ink
+          int x = cmd.x;
+          char* pText = strBuffer;
+          while (*pText)
+          {
+            bool inked = (cmd.inkChars >> (pText - strBuffer)) & 1;
+            char* pEnd = pText + 1;
+            while (*pEnd && ((cmd.inkChars >> (pEnd - strBuffer)) & 1) == inked)
+              pEnd++;
+            char ch = *pEnd;
+            *pEnd = 0;
+            SparseInk::SetInk(inked ? (SparseInk::Ink)cmd.ink : SparseInk::InkBlack);
+            StrokedFont::DrawText(x, cmd.y, pText, cmd.a, cmd.b, cmd.c);
+            *pEnd = ch;
+            x = StrokedFont::cursorX;
+            pText = pEnd;
+          }
+          SparseInk::SetInk(SparseInk::InkBlack);
         }
+        break;
+      case eIcon:
+        SparseInk::SetInk((SparseInk::Ink)cmd.ink);
+        Graphics::Weather(cmd.x, cmd.y, cmd.a);
+        SparseInk::SetInk(SparseInk::InkBlack);
+        break;
+      case eChar:
+        StrokedFont::DrawChar(cmd.x, cmd.y, cmd.a, 1);
+        break;
+      case eCounter:
+      {
+        char counter[8];
+        ITOA(cmd.a, counter);
+        Graphics::PaintUpdateCounter(counter);
+        break;
+      }
+    }
+  }
+
+  void Draw(byte kind, int x, int y, int a, int b = 0, int c = 0)
+  {
+    // draw, and remember it
+    DrawCommand cmd = {kind, (byte)((kind == eIcon) ? iconInk : textInk), (SparseInk::Coord)x, (SparseInk::Coord)y, (byte)a, (byte)b, (int8_t)c,
+                       (kind == eText) ? textInkChars : 0};
+    if (numDrawCommands < MAX_DRAW_COMMANDS)
+      drawCommands[numDrawCommands] = cmd;
+    numDrawCommands++;
+    Draw(cmd);
+  }
 
-#ifdef FOLD_CORNER    
-    // fold corner for that "paper" look
+  void DrawFold()
+  {
+#ifdef FOLD_CORNER
+    // fold corner for that "paper" look, the part in the current section
     const int foldSize = 15;
-    int r = row - (DISPLAY_HEIGHT - foldSize);
-    if (r >= 0)
+    if (!foldCorner)
+      return;
+    for (int row = max(sectionStart, DISPLAY_HEIGHT - foldSize); row <= sectionEnd; row++)
     {
-      for (int i = 0; i < r; i++)
-        Display::SetRowBufferAt(DISPLAY_HEIGHT - i - 1, Display::MonoBlack);
-      for (int i = 0; i < foldSize - r; i++)
-        Display::SetRowBufferAt(DISPLAY_HEIGHT - foldSize + i, r==0 ? Display::MonoBlack : Display::MonoGrey);
+      int r = row - (DISPLAY_HEIGHT - foldSize);
       if (r)
       {
-        Display::SetRowBufferAt(DISPLAY_HEIGHT - foldSize, Display::MonoBlack);
-        Display::SetRowBufferAt(DISPLAY_HEIGHT - r, Display::MonoBlack);
+        // black edges, grey between, over whatever's there
+        SparseInk::SetInk(SparseInk::InkGrey);
+        SparseInk::Span(row, DISPLAY_WIDTH - foldSize + 1, foldSize - r - 1);
+        SparseInk::SetInk(SparseInk::InkBlackOver);
+        SparseInk::Pixel(row, DISPLAY_WIDTH - foldSize);
+        SparseInk::Span(row, DISPLAY_WIDTH - r, r);
+      }
+      else
+      {
+        SparseInk::SetInk(SparseInk::InkBlackOver);
+        SparseInk::Span(row, DISPLAY_WIDTH - foldSize, foldSize);
       }
     }
-#endif    
+    SparseInk::SetInk(SparseInk::InkBlack);
+#endif
   }
 
-  byte sectionStart = 0xFF; // the first row in an updated section
-  Display::Colour foreground = Display::MonoBlack;
-  Display::Colour background = Display::MonoWhite;
+  void Redraw()
+  {
+    // SparseInk callback, draw the section again
+    for (int i = 0; i < numDrawCommands; i++)
+      Draw(drawCommands[i]);
+    DrawFold();
+  }
+
+  void ClearSection()
+  {
+    SparseInk::Clear(sectionStart);
+    numDrawCommands = 0;
+  }
 
-  void SendRows(byte y)
+  void SendRows(SparseInk::Coord y)
   {
     // start/end a section of the display, built up as we go down
-    if (sectionStart == 0xFF)
+    if (sectionStart == NO_SECTION)
     {
       // first.
       sectionStart = y;
-      SparseInk::Clear();
+      ClearSection();
     }
     else if (sectionStart < y)
     {
       // next. send rows from the start to here (y), update start
-      SparseInk::SendRows(sectionStart, y, foreground, background);
+      // if it overflowed, draw it again, in pieces
+      sectionEnd = y;
+      DrawFold();
+      SparseInk::Flush();
+#ifdef CONFIG_RETAIN_TH_LINE
+      bool retain = retainSection;
+      bool intoRetained = retainedLine.valid && !retainSection && sectionStart <= retainedLine.sectionEnd &&
+                          y >= retainedLine.sectionStart;
+      if (intoRetained)
+      {
+        // another section's on the retained line's rows (the layout's moved, or another page), SparseInk kept its pixels
+        // out of them, drop the line & draw again
+        SparseInk::Release();
+        retainedLine.valid = false;
+      }
+      if ((SparseInk::error || intoRetained) && numDrawCommands <= MAX_DRAW_COMMANDS)
+      {
+        // drawn again in pieces, so it can't be kept, and it's the whole line which is drawn again
+        retain = false;
+        if (retainSection)
+        {
+          SparseInk::Release();
+          strcpy(strBuffer, retainedLine.text);
+        }
+        SparseInk::Render(sectionStart, y, foreground, background, Redraw);
+      }
+      else
+        SparseInk::SendRows(sectionStart, y, foreground, background);
+      if (retainSection)
+      {
+        if (retain)
+          SparseInk::Retain(sectionStart, y);
+        retainedLine.valid = retain;
+        retainedLine.sectionEnd = y;
+      }
+#else
+      if (SparseInk::error && numDrawCommands <= MAX_DRAW_COMMANDS)
+        SparseInk::Render(sectionStart, y, foreground, background, Redraw);
+      else
+        SparseInk::SendRows(sectionStart, y, foreground, background);
+#endif
+#ifdef SPARSEINK_STATS
+      SparseInk::Dump(); // what the section took
+#endif
       sectionStart = y + 1;
-      SparseInk::Clear();
+      ClearSection();
     }
     if (y == DISPLAY_HEIGHT - 1) // reset
-      sectionStart = 0xFF;
+      sectionStart = NO_SECTION;
+  }
+
+  void SendRed()
+  {
+    // after the last section, the red plane, from the InkRed pixels SparseInk kept as the sections were sent
+    if (!SparseInk::HasRed())
+      Display::SendBlankRed(); // as usual
+    else
+    {
+      Display::StartRed();
+      SparseInk::SendRows(0, DISPLAY_HEIGHT - 1, Display::ColourRed, Display::ColourNone);
+    }
   }
 
 // style flags passed to Text below
@@ -83,12 +243,10 @@ namespace Page
 #define TXT_DBL_VT  0b00001010  // repeat text 1 pixel below
 #define TXT_DBL_HZ  0b00001100  // repeat text 1 pixel right
 #define TXT_QUAD    0b00001111  // repeat text offs (1, 0), (0, 1) & (1, 1)
-#define TXT_SPLIT   0b00010000  // split the test in half vertically, send each half to the display separately
 #define TXT_ITALIC  0b00100000  // slant the text
 #define TXT_CENTRE  0b01000000  // centre the text
 #define TXT_NOSEND  0b10000000  // don't automatically send the test to the display
 
-  char strBuffer[32];
   void Text(int x0, int y0, const char* pText, int scaleNum, int scaleDen, int charGap, uint8_t flags)
   {
     // if pText is *NOT* strBuffer, it is copied from PROGMEM to strBuffer
@@ -102,38 +260,74 @@ namespace Page
       StrokedFont::SetItalic(1, 4);
     if (flags & TXT_CENTRE)
       x0 = (DISPLAY_WIDTH - StrokedFont::Width(pText, scaleNum, scaleDen, charGap))/2;
-    int lastRow = 0, loops = 1;
-    if (flags & TXT_SPLIT)
+    Draw(eText, x0, y0, scaleNum, scaleDen, charGap);
+    if (flags & 0b0100)
+      Draw(eText, x0 + 1, y0, scaleNum, scaleDen, charGap);
+    if (flags & 0b0010)
+      Draw(eText, x0, y0 + 1, scaleNum, scaleDen, charGap);
+    if (flags & 0b0001)
+      Draw(eText, x0 + 1, y0 + 1, scaleNum, scaleDen, charGap);
+    if (!(flags & TXT_NOSEND))
     {
-      loops = 2;
-      lastRow = y0 + StrokedFont::Height(scaleNum, scaleDen, false)/2;
-      StrokedFont::SetClip(y0, lastRow);
+      SendRows(min(StrokedFont::cursorY, DISPLAY_HEIGHT - 1));
+      ClearSection();
     }
-    for (int loop = 0; loop < loops; loop++)
+    StrokedFont::SetItalic(0, 0);
+  }
+
+#ifdef CONFIG_RETAIN_TH_LINE
+  void TextRetained(int x, int y, int scaleNum, int scaleDen, int charGap)
+  {
+    // Text(x, y, strBuffer, ..., TXT_QUAD) for a line which is kept in SparseInk, see RetainedLine
+    // if it's where the last one was, just the chars which differ are erased and drawn, the others are left as spaces
+    if (strlen(strBuffer) >= sizeof(retainedLine.text))
     {
-      if (loop)
-        StrokedFont::SetClip(lastRow + 1, DISPLAY_HEIGHT - 1);
-      StrokedFont::DrawText(x0, y0, pText, scaleNum, scaleDen, charGap);
-      if (flags & 0b0100)
-        StrokedFont::DrawText(x0 + 1, y0, pText, scaleNum, scaleDen, charGap);
-      if (flags & 0b0010)
-        StrokedFont::DrawText(x0, y0 + 1, pText, scaleNum, scaleDen, charGap);
-      if (flags & 0b0001)
-        StrokedFont::DrawText(x0 + 1, y0 + 1, pText, scaleNum, scaleDen, charGap);
-      if (!(flags & TXT_NOSEND))
-      {
-        SendRows(min(StrokedFont::cursorY, DISPLAY_HEIGHT - 1));
-        SparseInk::Clear();
-      }
+      SparseInk::Release();
+      retainedLine.valid = false;
+      Text(x, y, strBuffer, scaleNum, scaleDen, charGap, TXT_QUAD);
+      return;
     }
-    StrokedFont::SetItalic(0, 0);
-    StrokedFont::SetClip(0, 0);
+    if (retainedLine.valid && retainedLine.sectionStart == sectionStart && retainedLine.x == x && retainedLine.y == y &&
+        retainedLine.inkChars == textInkChars && strlen(retainedLine.text) == strlen(strBuffer))
+    {
+      int lenChar = StrokedFont::Width(" ", scaleNum, scaleDen, charGap) + StrokedFont::Gap(scaleNum, scaleDen, charGap);
+      for (int i = 0; strBuffer[i]; i++)
+        if (strBuffer[i] == retainedLine.text[i])
+          strBuffer[i] = ' ';
+        else
+        {
+          retainedLine.text[i] = strBuffer[i];
+          SparseInk::EraseRect(sectionStart, DISPLAY_HEIGHT - 1, x + i*lenChar, x + (i + 1)*lenChar - 1);
+        }
+    }
+    else
+    {
+      // drop the old line, and keep this one
+      SparseInk::Release();
+      ClearSection();
+      strcpy(retainedLine.text, strBuffer);
+      retainedLine.sectionStart = sectionStart;
+      retainedLine.x = x;
+      retainedLine.y = y;
+      retainedLine.inkChars = textInkChars;
+    }
+    retainSection = true;
+    Text(x, y, strBuffer, scaleNum, scaleDen, charGap, TXT_QUAD);
+    retainSection = false;
   }
+#endif
 
   bool firstLoop = true;
+#ifdef RANDOM_FORECAST_IF_NONE
+  // drawn for a forecast of none, picked once per update (Loop), so every Paint of an update draws the same page
+  char randomLetter = 'A';
+#endif
   void Init()
   {
     randomSeed(Sensor::GetEntropy()); // introduce some randomness
+#ifdef RANDOM_FORECAST_IF_NONE
+    randomLetter = random('A', 'Z' + 1);
+#endif
     Display::Init();
     Weather::Init();
     firstLoop = true;
@@ -145,13 +339,17 @@ namespace Page
   void Splash()
   {
     // draw a splash, with the name, credit and all the icons
+#ifdef CONFIG_RETAIN_TH_LINE
+    SparseInk::Release();
+    retainedLine.valid = false;
+#endif
     foreground = Display::MonoBlack;
     background = Display::MonoWhite;
     Display::StartMono();
-    SparseInk::SetRuleCallback(nullptr);
+    foldCorner = false;
     SendRows(0);
     int num = 1, den = 1, gap = 5;
-    Text(0, 5, pProgramNameStr, num, den, gap, TXT_QUAD | TXT_CENTRE | TXT_SPLIT);
+    Text(0, 5, pProgramNameStr, num, den, gap, TXT_QUAD | TXT_CENTRE);
 
     const int rows = 3;
     const int cols = Graphics::NumWeatherIcons/rows;
@@ -161,7 +359,7 @@ namespace Page
     for (int row = 0; row < rows; row++)
     {
       for (int col = 0; col < cols; col++)
-        Graphics::Weather(x + col*Graphics::WeatherWidth(), y, row*cols + col);
+        Draw(eIcon, x + col*Graphics::WeatherWidth(), y, row*cols + col);
       y += rowHeight;
       SendRows(y);
     }
@@ -169,27 +367,17 @@ namespace Page
     num = den = 1;
     gap = 0;
 #ifdef SPLASH_CREDIT_RED
-    // trailing rows of monochrome
-    SendRows(DISPLAY_HEIGHT - 1);
-
-    // red part
-    Display::StartRed();
-    foreground = Display::ColourRed;
-    background = Display::ColourNone;
-    SendRows(0);
-    Text(0, DISPLAY_HEIGHT - StrokedFont::Height(num, den, false) - 3, pCreditStr, num, den, gap, TXT_CENTRE | TXT_ITALIC);
-    // trailing rows of red
-    SendRows(DISPLAY_HEIGHT - 1);
-#else
+    // drawn with the rest, sent with the red plane
+    textInk = SparseInk::InkRed;
+    textInkChars = ~(uint32_t)0;
+#endif
     Text(0, DISPLAY_HEIGHT - StrokedFont::Height(num, den, false) - 3, pCreditStr, num, den, gap, TXT_CENTRE | TXT_ITALIC);
+    textInk = SparseInk::InkDither;
+    textInkChars = 0;
     // trailing rows
     SendRows(DISPLAY_HEIGHT - 1);
 
-    Display::StartRed();
-    Display::FillRowBuffer(Display::ColourNone);
-    for (int row = 0; row < DISPLAY_HEIGHT; row++)
-      Display::SendRowBuffer();
-#endif
+    SendRed();
     Display::Refresh();
   }
 
@@ -209,22 +397,21 @@ namespace Page
     foreground = Display::MonoBlack;
     background = Display::MonoWhite;
     Display::StartMono();
-    SparseInk::SetRuleCallback(RuleFunc);
+    foldCorner = true;
     const char* pStr;
     bool randomForecast = false;
 #ifdef RANDOM_FORECAST_IF_NONE    
     if (!::isalpha(forecastLetter))
     {
-      forecastLetter = random('A', 'Z' + 1);
+      forecastLetter = randomLetter;
       randomForecast = true;
     }
 #endif      
     // **************** pressure
     SendRows(0);
 #ifdef DEBUG
-    ITOA(updateCounter, strBuffer);
-    Graphics::PaintUpdateCounter(strBuffer);
-    StrokedFont::DrawChar(DISPLAY_WIDTH - 10, 0, forecastLetter, 1);
+    Draw(eCounter, 0, 0, updateCounter);
+    Draw(eChar, DISPLAY_WIDTH - 10, 0, forecastLetter);
 #endif
     int num = 5, den = 2, gap = 0;
 #ifdef CONFIG_HECTO_PASCALS
@@ -241,7 +428,7 @@ namespace Page
       strBuffer[len - 1] = '.';
     }
 #endif
-    int offset = StrokedFont::Width(strBuffer, num, den, gap) + 2; // +2 for the doubling-up
+    int lenP = (int)strlen(strBuffer); // record length of Pressure w/out units
 #ifdef CONFIG_HECTO_PASCALS
     strcat_P(strBuffer, phPaStr);
 #else
@@ -249,14 +436,11 @@ namespace Page
 #endif
     int x = (DISPLAY_WIDTH - StrokedFont::Width(strBuffer, num, den, gap))/2;
     int y = 2;
-    // these are columns
-    ruleData[0] = x + offset;
-    ruleData[1] = DISPLAY_WIDTH - 1;
-    ruleData[2] = -1; // off
-#ifdef DEBUG
-    ruleData[1] -= 10; // exclude debug forecast letter
+#ifdef DITHER_UNITS
+    textInkChars = ~(uint32_t)0 << lenP; // dither the units
 #endif
-    Text(x, y, strBuffer, num, den, gap, TXT_QUAD | TXT_SPLIT);
+    Text(x, y, strBuffer, num, den, gap, TXT_QUAD);
+    textInkChars = 0;
     y = StrokedFont::cursorY + 1;
 
     // **************** pressure trend
@@ -269,16 +453,13 @@ namespace Page
     else
       pStr = pNAStr;
     num = 1; den = 1; gap = 4;
-    ruleData[0] = -1; // off
     Text(x, y, pStr, num, den, gap, TXT_QUAD | TXT_ITALIC | TXT_CENTRE);
     
-    // dither random forecast
-    ditherForecast = randomForecast;
+    // dither random forecast, extra light
     if (randomForecast)
     {
-      ruleData[0] = 0;
-      ruleData[1] = DISPLAY_WIDTH - 1;
-      ditherAltColour = Display::MonoWhite; // extra light
+      iconInk = textInk = SparseInk::InkDitherLight;
+      textInkChars = ~(uint32_t)0;
     }
     // **************** forecast icon
     y = StrokedFont::cursorY;
@@ -286,7 +467,7 @@ namespace Page
     {
       // map the letter range A-Z to the icon range Sunny-Stormy
       int icon = min((forecastLetter - 'A')/(('Z'-'A' + 1)/Graphics::NumWeatherIcons), Graphics::NumWeatherIcons - 1);
-      Graphics::Weather((DISPLAY_HEIGHT - Graphics::WeatherWidth())/2, y, icon);
+      Draw(eIcon, (DISPLAY_HEIGHT - Graphics::WeatherWidth())/2, y, icon);
     }
     y += Graphics::WeatherHeight();
     SendRows(y);
@@ -310,8 +491,9 @@ namespace Page
       Text(x, y, pStr, num, den, gap, TXT_DBL_VT);
       Text(x, StrokedFont::cursorY, pStr2, num, den, gap, TXT_DBL_VT);
     }
-    ditherForecast = false;
-    ditherAltColour = Display::MonoGrey;
+    iconInk = SparseInk::InkBlack;
+    textInk = SparseInk::InkDither;
+    textInkChars = 0;
 
     // **************** temperature & humidity
     num = 5; den = 2;
@@ -336,43 +518,86 @@ namespace Page
       strcat(strBuffer, "%"); // and units
     }
     x = (DISPLAY_WIDTH - StrokedFont::Width(strBuffer, num, den, gap))/2; // centre
-    // set the dithering regions
-    ruleData[0] = x + lenT*lenChar;
-    ruleData[1] = ruleData[0] + 2*lenChar;
+#ifdef DITHER_UNITS
+    // dither the units
+    textInkChars = 0b11UL << lenT;
     if (humidity_Percent >= 0)
-    {
-      ruleData[2] = x + StrokedFont::Width(strBuffer, num, den, gap) - (lenChar - StrokedFont::Gap(num, den, gap));
-      ruleData[3] = DISPLAY_WIDTH - 1;
-    }
-    Text(x, y, strBuffer, num, den, gap, TXT_QUAD | TXT_SPLIT);
+      textInkChars |= 1UL << (strlen(strBuffer) - 1);
+#endif
+#ifdef CONFIG_RETAIN_TH_LINE
+    TextRetained(x, y, num, den, gap);
+#else
+    Text(x, y, strBuffer, num, den, gap, TXT_QUAD);
+#endif
+    textInkChars = 0;
 
     // trailing rows
     SendRows(DISPLAY_HEIGHT - 1);
-    SparseInk::SetRuleCallback(nullptr);
+    foldCorner = false;
 
-    // No red pixels:
-    Display::StartRed();
-    Display::FillRowBuffer(Display::ColourNone);
-    for (int row = 0; row < DISPLAY_HEIGHT; row++)
-      Display::SendRowBuffer();
+    SendRed();
+    Display::BeginRefresh(); // Loop sees it through
+  }
 
-    Display::Refresh();
+  void PaintWeather()
+  {
+    Paint(Weather::GetPressure(), Weather::GetForecastLetter(), Weather::GetPressureTrend(), Weather::GetTemperature(), Weather::GetHumidity());
+  }
+
+#ifdef DISPLAY_LUT_PROFILES
+  uint8_t fastSinceFull = 0; // pages refreshed with LUTFast since a full one
+#endif
+
+  void Wake(bool smallChange)
+  {
+    // power the panel up, with the LUTs for the temperature & how much changed, picked first so Init sends them just once
+#ifdef DISPLAY_LUT_PROFILES
+    Display::LUTProfile luts = Display::ChooseLUTs(Weather::GetTemperature(), smallChange, fastSinceFull);
+    fastSinceFull = (luts == Display::LUTFast) ? fastSinceFull + 1 : 0;
+    Display::SetLUTs(luts);
+#else
+    (void)smallChange;
+#endif
+    Display::Init();
   }
 
   void Loop()
   {
 #ifdef DEMO
     Weather::Loop();
-    Paint(Weather::GetPressure(), Weather::GetForecastLetter(), Weather::GetPressureTrend(), Weather::GetTemperature(), Weather::GetHumidity());
+    PaintWeather();
     while (true)
       ;
 #else    
+    Display::Poll(); // the last page's refresh & sleep
     if (Weather::Loop() || firstLoop)
     {
-      Display::Init(); // wake
-      Paint(Weather::GetPressure(), Weather::GetForecastLetter(), Weather::GetPressureTrend(), Weather::GetTemperature(), Weather::GetHumidity());
+#ifdef RANDOM_FORECAST_IF_NONE
+      if (!firstLoop)
+        randomLetter = random('A', 'Z' + 1); // the update's, Init picked the first
+#endif
+#ifdef DISPLAY_PARTIAL
+      // draw it once just to see which rows changed, if none did there's nothing to do
+      // if they're under half the page, just they are sent & refreshed
+      int first, last;
+      Display::StartHashing();
+      PaintWeather();
+      if (Display::EndHashing(first, last) || firstLoop)
+      {
+        bool window = !firstLoop && last - first + 1 <= DISPLAY_HEIGHT/2;
+        Wake(window);
+        if (window)
+          Display::StartWindow(first, last);
+        PaintWeather();
+        updateCounter++;
+        Display::BeginSleep();
+      }
+#else
+      Wake(false); // without the hashing there's no telling how much changed
+      PaintWeather();
       updateCounter++;
-      Display::Sleep();
+      Display::BeginSleep();
+#endif
       firstLoop = false;
     }
 #endif    
@@ -63,3 +63,35 @@
 #else
 board not implemented!
 #endif
+
+// The display's control pins as types, Pin<PIN_DISPLAY_CS>::Low() etc. Where the port & bit are known (below) each is a
+// single instruction (sbi/cbi/sbic), the pins are only ever outputs or inputs so there's no PWM to turn off.
+// Otherwise (another board, or a PC build) digitalWrite/digitalRead. include after Arduino.h
+template <int pin> struct Pin
+{
+  static void High() { digitalWrite(pin, HIGH); }
+  static void Low()  { digitalWrite(pin, LOW); }
+  static bool Read() { return digitalRead(pin); }
+};
+
+#ifdef __AVR__
+#define FAST_PIN(_pin, _port, _bit) \
+template <> struct Pin<_pin> \
+{ \
+  static void High() { PORT##_port |= _BV(_bit); } \
+  static void Low()  { PORT##_port &= ~_BV(_bit); } \
+  static bool Read() { return PIN##_port & _BV(_bit); } \
+};
+#if defined(ARDUINO_AVR_LEONARDO_ETH)
+FAST_PIN(PIN_DISPLAY_BUSY, F, 7) // A0
+FAST_PIN(PIN_DISPLAY_RST,  B, 7) // D11
+FAST_PIN(PIN_DISPLAY_DC,   B, 6) // D10
+FAST_PIN(PIN_DISPLAY_CS,   B, 5) // D9
+#elif defined(ARDUINO_AVR_UNO)
+FAST_PIN(PIN_DISPLAY_BUSY, D, 7) // D7
+FAST_PIN(PIN_DISPLAY_RST,  B, 0) // D8
+FAST_PIN(PIN_DISPLAY_DC,   B, 1) // D9
+FAST_PIN(PIN_DISPLAY_CS,   B, 2) // D10
+#endif
+#undef FAST_PIN
+#endif
@@ -1,283 +1,852 @@
 #include <Arduino.h>
 #include "Display.h"
 #include "SparseInk.h"
+#include "Arena.h"
 
 namespace SparseInk {
-  // limited to 200x200 rows & cols, 0..199
+  // the table is Coords, bytes for this 200x200 panel (shown below), 16 bits for larger ones, see SparseInk.h
   //  {row0} { col0 } { col1 }...{0xFF}
   //  {row1} { col0 } { col1 }...{0xFF}
   //  ...
-  //  but, {col} followed by a byte (len) 200..254 means a run of len-197
-#define TABLE_SIZE 1000
-#define END 255
+  //  but, {col} followed by a byte (len) 200..247 means a run of len-197
+  //  runs are kept up to date as pixels are added, adjacent cols are merged into runs (3 or more) as they touch
+  //  and a dense row is stored as {row} {0xFE} {25 bytes, 1 bit per col, MSB first}, no {0xFF}
+  //  rows switch to that once their cols & runs would take more bytes
+  //  pixels not in InkBlack go in their own record for the row, tagged with the ink, {row} {0xF8+ink} {cols...}
+  //  a row's records are in ink order, InkRed's last
+  // InkRed records are for the red plane, and Clear keeps them for the rows above the band, see SendRows
+  // Clear also keeps the retained rows, whatever their inks, see Retain, parked at the top of the table while a band
+  // above them is drawn
+  // with 16 bits, END etc are the same codes counting down from 0xFFFF, runs start at the width & are never split
+  // the table is in the arena, TABLE_SIZE bytes
+#define TABLE_ENTRIES ((int)(TABLE_SIZE/sizeof(Coord)))
+#define END ((Coord)~0)
 #define COLOUR_FORE Display::MonoBlack
 #define COLOUR_BACK Display::MonoWhite
 #define COLOUR_GREY Display::MonoGrey
-#define RUN_LEN_MIN 200
-#define RUN_LEN_MAX 254
+#define RUN_LEN_MIN max(DISPLAY_WIDTH, DISPLAY_HEIGHT)
+#define RUN_LEN_MAX (INK_TAG - 1)
 #define RUN_LEN_LOW 3
+#define RUN_PIXELS_MAX (RUN_LEN_MAX - RUN_LEN_MIN + RUN_LEN_LOW) // longer runs are split
+  // the row directory covers the DIR_ROWS rows from dirBase, enough for the tallest band Page sends
+  // rowDir[i] is the offset of the first row >= dirBase+i (so its record if it's present, otherwise where it goes)
+#define DIR_ROWS 48
+#define BITMAP (END - 1)
+#define INK_TAG (END - 7)
+#define BITMAP_BYTES (DISPLAY_WIDTH/8)
+#define BITMAP_SIZE ((int)((BITMAP_BYTES + sizeof(Coord) - 1)/sizeof(Coord))) // in Coords, signed to compare with pointer differences
 
-  byte table[TABLE_SIZE];
-  int tableTop = 0; // index of first unused byte
+  Coord (&table)[TABLE_ENTRIES] = Arena::ram.table;
+  int tableTop = 0; // index of first unused entry
+  int tableEnd = TABLE_ENTRIES;   // the parked retained rows are above this, see Park
+  int tableLimit = TABLE_ENTRIES; // the table can grow up to this, the batch log is above it, see Flush
   int tableHighWater = 0;
   Error error = eNone;
+  uint16_t rowDir[DIR_ROWS];
+  Coord dirBase = 0;
+  byte tintedRows[DIR_ROWS/8]; // bit set if the directory row has records with other inks
+  Ink ink = InkBlack;
+  bool redRecords = false; // the table may have InkRed records
+  // the rows Clear keeps, none if retainFirst > retainLast
+  Coord retainFirst = END;
+  Coord retainLast = 0;
+  Coord drawLast = DISPLAY_HEIGHT - 1; // no drawing below this, into retained rows, from a band above them
+  // pixels outside these rows are ignored, see Render
+  Coord windowFirst = 0;
+  Coord windowLast = DISPLAY_HEIGHT - 1;
+  // the cursor is the last entry touched by Pixel, strokes tend to stay in the same row, so search from there
+  Coord cursorRow = END; // END if none
+  Ink cursorInk = InkBlack;
+  int cursorRowPos = 0; // offset of cursorRow's record for cursorInk
+  int cursorPos = 0;    // offset of the entry in that row
+#ifdef SPARSEINK_BATCH
+  // the log of pixels not yet inserted, keys (row:col), down from the top of the table, with as much again below it to
+  // sort into, see Flush
+#if DISPLAY_WIDTH <= 200 && DISPLAY_HEIGHT <= 200
+  typedef uint16_t Key;
+#else
+  typedef uint32_t Key;
+#endif
+#define KEY_COL_BITS (sizeof(Coord)*8)
+  Key* logEnd = (Key*)((uintptr_t)(table + TABLE_ENTRIES) & ~(uintptr_t)(sizeof(Key) - 1)); // below any parked rows
+  int logCount = 0;
+#endif
+#ifdef SPARSEINK_STATS
+  Stats stats;
+#define STAT(_stmt) _stmt
+#else
+#define STAT(_stmt)
+#endif
   
-  void Clear()
+  Ink RecordInk(Coord* ptr)
   {
-    // clear the table, just the <end> row
-    *table = END;
-    tableTop = 1;
-    error = eNone;
+    // the ink of the record at ptr
+    Coord tag = *(ptr + 1);
+    return (INK_TAG < tag && tag < BITMAP) ? (Ink)(tag - INK_TAG) : InkBlack;
   }
 
-  void Pixel(byte row, byte col)
+  Coord* RecordData(Coord* ptr)
   {
-    // add the given pixel to the sparse data
-    if (col >= RUN_LEN_MIN || row >= DISPLAY_HEIGHT || error)
-      return;
-    // find the row
-    byte* ptr = table;
+    // the first col (or BITMAP) of the record at ptr, after the row # and any ink tag
+    return ptr + (RecordInk(ptr) == InkBlack ? 1 : 2);
+  }
+
+  bool IsRun(Coord len)
+  {
+    // true if the entry after a col is a run length
+    return RUN_LEN_MIN <= len && len <= RUN_LEN_MAX;
+  }
+
+  Coord* NextEntry(Coord* ptr)
+  {
+    // the col (or run) following ptr's
+    return ptr + (IsRun(*(ptr + 1)) ? 2 : 1);
+  }
+
+  Coord* PrevEntry(Coord* ptr)
+  {
+    // the col (or run) preceding ptr's, there must be one
+    return ptr - (IsRun(*(ptr - 1)) ? 2 : 1);
+  }
+
+  Coord* NextRow(Coord* ptr)
+  {
+    // the record after the one at ptr
+    ptr = RecordData(ptr);
+    if (*ptr == BITMAP)
+      return ptr + 1 + BITMAP_SIZE;
+    do
+      ptr++;
+    while (*ptr != END);
+    return ptr + 1;
+  }
+
+  Coord* FindRow(Coord row)
+  {
+    // return the row's (first) record, or where it would be inserted
+    // rows in the directory are found directly, others are scanned for, from the nearest known row
+    Coord* ptr = table;
+    if (row >= dirBase)
+      ptr += rowDir[min(row - dirBase, DIR_ROWS - 1)];
+    if (cursorRow < row && cursorRowPos > ptr - table)
+      ptr = table + cursorRowPos;
     while (*ptr < row)
     {
-      // go to the end of the row
-      do
-        ptr++;
-      while (*ptr != END);
+      ptr = NextRow(ptr);
+      STAT(stats.rowSteps++);
+    }
+    return ptr;
+  }
+
+  Coord* FindRecord(Coord row, Ink recordInk)
+  {
+    // return the row's record for the ink, or where it would be inserted
+    Coord* ptr = FindRow(row);
+    while (*ptr == row && RecordInk(ptr) < recordInk)
+    {
+      ptr = NextRow(ptr);
+      STAT(stats.rowSteps++);
+    }
+    return ptr;
+  }
+
+  bool InDirectory(Coord row)
+  {
+    return dirBase <= row && row < dirBase + DIR_ROWS - 1;
+  }
+
+  bool Retained(Coord row)
+  {
+    return retainFirst <= row && row <= retainLast;
+  }
+
+  void Park()
+  {
+    // move the retained rows to the top of the table, so the band above them is inserted without moving them too
+    // after Clear's compacting they're the last records, the rest are red ones from before the band
+    Coord* ptr = table;
+    while (*ptr < retainFirst)
+      ptr = NextRow(ptr);
+    int size = tableTop - 1 - (ptr - table);
+    tableEnd = TABLE_ENTRIES - size;
+    STAT(stats.bytesMoved += size*sizeof(Coord));
+    ::memmove(table + tableEnd, ptr, size*sizeof(Coord));
+    *ptr = END;
+    tableTop = ptr - table + 1;
+  }
+
+  void Unpark()
+  {
+    // put the parked rows back at the end of the table, the band above them only had records before them
+    int size = TABLE_ENTRIES - tableEnd;
+    STAT(stats.bytesMoved += size*sizeof(Coord));
+    ::memmove(table + tableTop - 1, table + tableEnd, size*sizeof(Coord));
+    tableTop += size;
+    table[tableTop - 1] = END;
+    tableEnd = TABLE_ENTRIES;
+  }
+
+  void Clear(Coord firstRow)
+  {
+    // clear the table, just the <end> row, after the records it keeps, moved to the start:
+    // the red records of the rows before firstRow, and the retained rows, parked if the band's above them
+    if (tableEnd < TABLE_ENTRIES)
+      Unpark();
+    Coord* top = table;
+    bool red = false;
+    if (!tableTop) // never cleared
+      *table = END;
+    else if (redRecords || retainFirst <= retainLast)
+      for (Coord* ptr = table; *ptr != END; )
+      {
+        Coord* next = NextRow(ptr);
+        if ((RecordInk(ptr) == InkRed && *ptr < firstRow) || Retained(*ptr))
+        {
+          red |= (RecordInk(ptr) == InkRed);
+          ::memmove(top, ptr, (next - ptr)*sizeof(Coord));
+          top += next - ptr;
+        }
+        ptr = next;
+      }
+    *top = END;
+    tableTop = top - table + 1;
+    redRecords = red;
+    error = eNone;
+    if (firstRow < retainFirst && retainFirst <= retainLast)
+      Park();
+#ifdef SPARSEINK_BATCH
+    logCount = 0;
+    logEnd = (Key*)((uintptr_t)(table + tableEnd) & ~(uintptr_t)(sizeof(Key) - 1));
+#endif
+    tableLimit = tableEnd;
+    dirBase = firstRow;
+    drawLast = (firstRow < retainFirst && retainFirst <= retainLast) ? retainFirst - 1 : DISPLAY_HEIGHT - 1;
+    windowLast = drawLast;
+    // the directory, over any rows kept
+    ::memset(tintedRows, 0, sizeof(tintedRows));
+    Coord* ptr = table;
+    for (int i = 0; i < DIR_ROWS; i++)
+    {
+      while (*ptr != END && *ptr < dirBase + i)
+      {
+        if (InDirectory(*ptr) && RecordInk(ptr) != InkBlack)
+          tintedRows[(*ptr - dirBase) >> 3] |= 1 << ((*ptr - dirBase) & 7);
+        ptr = NextRow(ptr);
+      }
+      rowDir[i] = ptr - table;
+    }
+    cursorRow = END;
+  }
+
+  void Retain(Coord firstRow, Coord lastRow)
+  {
+    // from the next Clear, keep these rows, so they can be edited rather than drawn again
+    retainFirst = firstRow;
+    retainLast = lastRow;
+  }
+
+  void Release()
+  {
+    // the next Clear drops the retained rows
+    retainFirst = END;
+    retainLast = 0;
+  }
+
+  void Shuffle(Coord row, Coord* ptr, int entries)
+  {
+    // move the table from ptr (in or before row's record) up by entries (or down if -ve), just the entries in use
+    // and the directory's following rows
+    STAT(stats.bytesMoved += (tableTop - (ptr - table))*sizeof(Coord));
+    ::memmove(ptr + entries, ptr, (tableTop - (ptr - table))*sizeof(Coord));
+    tableTop += entries;
+    STAT(stats.peak = max(stats.peak, tableTop + TABLE_ENTRIES - tableEnd)); // and any parked rows
+    for (int i = max(row - dirBase + 1, 0); i < DIR_ROWS; i++)
+      rowDir[i] += entries;
+  }
+
+  Coord* KnownEnd(Coord row, Ink recordInk)
+  {
+    // the END of the row's (not bitmap) record for the ink, if the directory gives it, otherwise nullptr
+    // that's when it's the row's last record, the only one if it's black
+    if (InDirectory(row) && recordInk == InkBlack && !(tintedRows[(row - dirBase) >> 3] & (1 << ((row - dirBase) & 7))))
+      return table + rowDir[row - dirBase + 1] - 1;
+    return nullptr;
+  }
+
+  Coord* RowEnd(Coord row, Coord* ptr)
+  {
+    // the END of the (not bitmap) record containing ptr
+    Coord* endPtr = KnownEnd(row, ink);
+    if (endPtr)
+      return endPtr;
+    while (*ptr != END)
       ptr++;
+    return ptr;
+  }
+
+  Coord EntryLen(Coord* ptr)
+  {
+    // the number of pixels in the entry (col or run) at ptr
+    Coord len = *(ptr + 1);
+    return IsRun(len) ? len - (RUN_LEN_MIN - RUN_LEN_LOW) : 1;
+  }
+
+  Coord EncodedSize(Coord len)
+  {
+    // the number of entries Encode uses for a run of len pixels
+    Coord size = 0;
+    while (len)
+    {
+      Coord n = min(len, RUN_PIXELS_MAX);
+      size += (n < RUN_LEN_LOW) ? n : 2;
+      len -= n;
     }
-    if (*ptr > row) // insert new row, col, END
+    return size;
+  }
+
+  void Encode(Coord* ptr, Coord col, Coord len)
+  {
+    // store a run of len pixels from col at ptr, short ones as cols, long ones as several runs
+    while (len)
     {
-      if (tableTop + 3 >= TABLE_SIZE)
+      Coord n = min(len, RUN_PIXELS_MAX);
+      if (n < RUN_LEN_LOW)
+        for (Coord i = 0; i < n; i++)
+          *ptr++ = col + i;
+      else
+      {
+        *ptr++ = col;
+        *ptr++ = RUN_LEN_MIN + (n - RUN_LEN_LOW);
+      }
+      col += n;
+      len -= n;
+    }
+  }
+
+  void SetBits(byte* bits, Coord col, Coord len)
+  {
+    // set len bits from col in the bitmap
+    while (len--)
+    {
+      bits[col >> 3] |= 0b10000000 >> (col & 7);
+      col++;
+    }
+  }
+
+  void ToBitmap(Coord row, Coord* first, Coord* endPtr)
+  {
+    // replace the record's cols & runs, from first, with a bitmap
+    byte bits[BITMAP_BYTES];
+    ::memset(bits, 0, sizeof(bits));
+    for (Coord* ptr = first; ptr < endPtr; ptr = NextEntry(ptr))
+      SetBits(bits, *ptr, EntryLen(ptr));
+    int size = BITMAP_SIZE - (endPtr - first); // less the old entries & END
+    Shuffle(row, endPtr + 1, size);
+    *first = BITMAP;
+    ::memcpy(first + 1, bits, BITMAP_BYTES);
+    cursorRow = END;
+  }
+
+  void Insert(Coord row, Coord col, Coord len)
+  {
+    // add a run of len pixels to the sparse data, merging it with any entries it touches or overlaps
+    STAT(stats.inserts++);
+    Coord* ptr = (row == cursorRow && ink == cursorInk) ? table + cursorRowPos : FindRecord(row, ink);
+    if (*ptr != row || RecordInk(ptr) != ink) // insert new record, [tag,] run, END
+    {
+      Coord tagged = (ink != InkBlack);
+      int size = EncodedSize(len) + 2 + tagged;
+      if (tableTop + size >= tableLimit)
       {
         error = eRowFull;
+        STAT(stats.errors++);
         return;
       }
-      // shuffle
-      ::memmove(ptr + 3, ptr, TABLE_SIZE - (ptr - table) - 3);
-      tableTop += 3;
-      *ptr++ = row;
-      *ptr++ = col;
-      *ptr   = END;
+      Shuffle(row, ptr, size);
+      if (tagged && InDirectory(row))
+        tintedRows[(row - dirBase) >> 3] |= 1 << ((row - dirBase) & 7);
+      if (ink == InkRed)
+        redRecords = true;
+      cursorRow = row;
+      cursorInk = ink;
+      cursorRowPos = ptr - table;
+      cursorPos = cursorRowPos + 1 + tagged;
+      *ptr = row;
+      if (tagged)
+        *(ptr + 1) = INK_TAG + ink;
+      Encode(ptr + 1 + tagged, col, len);
+      *(ptr + size - 1) = END;
+    }
+    else if (*RecordData(ptr) == BITMAP)
+    {
+      // dense row, no searching or shuffling
+      SetBits((byte*)(RecordData(ptr) + 1), col, len);
     }
     else
     {
-      // update row
-      byte len = 0;
-      do
+      // update record, find the first entry at or after col, from the cursor if it's in this record
+      // otherwise from whichever end of the record is closer, if the end is known
+      Coord* rowPtr = ptr;
+      Coord* first = RecordData(ptr);
+      ptr = first;
+      STAT(stats.lookups++);
+      if (row == cursorRow && ink == cursorInk)
+      {
+        STAT(stats.cursorHits++);
+        ptr = table + cursorPos;
+      }
+      else
+      {
+        Coord* endPtr = KnownEnd(row, ink);
+        if (endPtr && col - *ptr > *PrevEntry(endPtr) - col)
+          ptr = endPtr;
+      }
+      while (ptr > first && *PrevEntry(ptr) >= col) // search back
+      {
+        ptr = PrevEntry(ptr);
+        STAT(stats.colSteps++);
+      }
+      while (*ptr < col) // search forward
       {
-        if (len > 1)
-          ptr++;
-        ptr++;
-        len = *(ptr + 1);
-        if (RUN_LEN_MIN <= len && len <= RUN_LEN_MAX)
-          len -= (RUN_LEN_MIN - RUN_LEN_LOW);
-        else
-          len = 1;
-      } while (*ptr < col);
-      if (*ptr > col) // insert col before ptr
+        ptr = NextEntry(ptr);
+        STAT(stats.colSteps++);
+      }
+      cursorRow = row;
+      cursorInk = ink;
+      cursorRowPos = rowPtr - table;
+      cursorPos = ptr - table;
+      int last = col + len - 1;
+      if (*ptr == col && EntryLen(ptr) >= len)
+      {
+        STAT(stats.duplicates++);
+        return; // already present
+      }
+      // extend back over the entries which touch the run
+      Coord* start = ptr;
+      while (start > first)
       {
-        if (tableTop + 1 >= TABLE_SIZE)
+        Coord* prev = PrevEntry(start);
+        int prevLast = *prev + EntryLen(prev) - 1;
+        if (prevLast + 1 < col)
+          break;
+        if (start == ptr && prevLast >= last)
         {
-          error = eColumnFull;
-          return;
+          STAT(stats.duplicates++);
+          return; // already present
         }
-        // shuffle
-        ::memmove(ptr + 1, ptr, TABLE_SIZE - (ptr - table) - 1);
-        tableTop++;
-        *ptr = col;
+        col = *prev;
+        last = max(last, prevLast);
+        start = prev;
       }
-      else
+      // and forward
+      Coord* end = ptr;
+      while (*end <= last + 1)
+      {
+        last = max(last, *end + EntryLen(end) - 1);
+        end = NextEntry(end);
+      }
+      // replace those entries with the merged run
+      len = last - col + 1;
+      int size = EncodedSize(len) - (end - start);
+      if (tableTop + size >= tableLimit)
+      {
+        error = eColumnFull;
+        STAT(stats.errors++);
+        return;
+      }
+      Shuffle(row, end, size);
+      Encode(start, col, len);
+      cursorPos = start - table;
+      if (size > 0)
       {
-        // already present
-        if (len > 1)
-          error = ePacked;
+        Coord* endPtr = RowEnd(row, start);
+        if (endPtr - first > BITMAP_SIZE)
+          ToBitmap(row, first, endPtr);
       }
     }
   }
 
-  void Pack(byte*& ptr, byte& len)
+#ifdef SPARSEINK_BATCH
+  // Pixel appends to a log, sorted and inserted, run by run, when it fills up, the ink changes or the table is read
+  void LogLimit()
   {
-    // replace the run with the encoded length
-    // ptr points past the last col in the run
-    // eg 10,11,12,13,17 will call with ptr @ 17, len = 4
-    // after 10,201,17 ptr @ 17, len = 0
-    if (RUN_LEN_LOW <= len && len < (RUN_LEN_MAX - RUN_LEN_LOW))
+    // the table stops below the log & the room to sort it
+    tableLimit = logCount ? (Coord*)(logEnd - 2*logCount) - table : tableEnd;
+  }
+
+  Key* SortLog()
+  {
+    // radix sort the log, 4 bits at a time, least significant first, into the space below it and back
+    // returns wherever the keys ended up, digits all the keys share are skipped
+    Key* from = logEnd - logCount;
+    Key* to = from - logCount;
+    for (byte shift = 0; shift < sizeof(Key)*8; shift += 4)
     {
-      // shuffle
-      ::memmove(ptr - (len - 2), ptr, TABLE_SIZE - (ptr - table) - 1);
-      *(ptr - (len - 1)) = RUN_LEN_MIN + (len - RUN_LEN_LOW);
-      tableTop -= len - 2;
-      ptr -= len - 2;
-      len = 0;
+      int starts[16];
+      ::memset(starts, 0, sizeof(starts));
+      for (int i = 0; i < logCount; i++)
+        starts[(from[i] >> shift) & 15]++;
+      if (starts[(from[0] >> shift) & 15] == logCount)
+        continue;
+      int pos = 0;
+      for (byte d = 0; d < 16; d++)
+      {
+        int n = starts[d];
+        starts[d] = pos;
+        pos += n;
+      }
+      for (int i = 0; i < logCount; i++)
+        to[starts[(from[i] >> shift) & 15]++] = from[i];
+      Key* swap = from;
+      from = to;
+      to = swap;
     }
+    return from;
   }
 
-  int Pack()
+  void Flush()
   {
-    // packs the column data by replacing consecutive cols with encoded lengths
-    // skips the rest of a row if it finds it's already been packed
-    // returns bytes saved
-    // NOTE: Not actually used here, an experiment.  Not a general solution, packed entries are not updated, use with caution!
-    if (error)
-      return -1;
-    int start = tableTop;
-    byte* ptr = table;
-    while (*ptr != END)
+    // insert the logged pixels, duplicates dropped and adjacent cols merged into runs
+    // the table grows into the keys already inserted
+    if (!logCount)
+      return;
+    STAT(stats.flushes++);
+    Key* keys = SortLog();
+    int count = logCount;
+    logCount = 0;
+    for (int i = 0; i < count && !error; )
+    {
+      Key key = keys[i];
+      Coord len = 1;
+      while (++i < count && keys[i] <= key + len)
+        if (keys[i] == key + len)
+          len++;
+      tableLimit = (Coord*)(keys + i) - table;
+      Insert(key >> KEY_COL_BITS, key & (Key)(Coord)~0, len);
+    }
+    tableLimit = tableEnd;
+  }
+
+  void Pixel(Coord row, Coord col)
+  {
+    // log the given pixel, it's added to the sparse data by Flush
+    if (col >= DISPLAY_WIDTH || row < windowFirst || row > windowLast || error)
+      return;
+    if ((Coord*)(logEnd - 2*(logCount + 1)) < table + tableTop + 2)
     {
-      byte start_col, run_len, col;
-      ptr++; // over the row #
-      // start a run
-      start_col = *ptr;
-      run_len = 1;
-      while (*ptr != END)
+      Flush();
+      if ((Coord*)(logEnd - 2) < table + tableTop + 2)
       {
-        byte len = *(ptr + 1);
-        if (RUN_LEN_MIN <= len && len <= RUN_LEN_MAX)  // row has been packed, skip it
-          do
-            ptr++;
-        while (*ptr != END);
-        else
-        {
-          col = *ptr;
-          if (col == (start_col + run_len) && run_len < (RUN_LEN_MAX - RUN_LEN_LOW))
-            run_len++; // extend the run
-          else
-          {
-            Pack(ptr, run_len); // pack what we have & start again
-            start_col = *ptr;
-            run_len = 1;
-          }
-          ptr++;
-        }
+        Insert(row, col, 1); // no room for a log
+        return;
       }
-      Pack(ptr, run_len); // pack what we have at the end
-      ptr++; // over the 0xFF at the end of the row
     }
-    return start - tableTop;
+    logCount++;
+    *(logEnd - logCount) = ((Key)row << KEY_COL_BITS) | col;
+    LogLimit();
+  }
+#else
+  void Flush()
+  {
   }
 
-  RuleCallback ruleCallback = nullptr;
-  void SetRuleCallback(RuleCallback func)
+  void Pixel(Coord row, Coord col)
   {
-    // called before each row buffer is sent
-    ruleCallback = func;
+    // add the given pixel to the sparse data
+    if (col >= DISPLAY_WIDTH || row < windowFirst || row > windowLast || error)
+      return;
+    Insert(row, col, 1);
+  }
+#endif
+
+  void SetInk(Ink newInk)
+  {
+    if (newInk != ink)
+      Flush(); // the log is all one ink
+    ink = newInk;
+  }
+
+  void Span(Coord row, Coord col, Coord len)
+  {
+    // add len pixels from col, in one go
+    if (col >= DISPLAY_WIDTH || row < windowFirst || row > windowLast || !len || error)
+      return;
+    Insert(row, col, min(len, DISPLAY_WIDTH - col));
+  }
+
+  Coord* EraseRecord(Coord* ptr, Coord firstCol, Coord lastCol)
+  {
+    // remove the record's pixels from firstCol to lastCol (INCLUSIVE), returns the next record
+    Coord row = *ptr;
+    Coord* first = RecordData(ptr);
+    if (*first == BITMAP)
+    {
+      byte* bits = (byte*)(first + 1);
+      for (int col = firstCol; col <= lastCol; col++)
+        bits[col >> 3] &= ~(0b10000000 >> (col & 7));
+      return NextRow(ptr);
+    }
+    // the entries overlapping the columns, from start to end, are replaced by what's left either side
+    Coord* start = first;
+    while (*start != END && *start + EntryLen(start) <= firstCol)
+      start = NextEntry(start);
+    Coord* end = start;
+    int last = -1; // of the overlapping entries
+    while (*end <= lastCol)
+    {
+      last = *end + EntryLen(end) - 1;
+      end = NextEntry(end);
+    }
+    if (end == start)
+      return NextRow(ptr); // none
+    Coord leftLen = (*start < firstCol) ? firstCol - *start : 0;
+    Coord leftCol = *start;
+    Coord rightLen = (last > lastCol) ? last - lastCol : 0;
+    if (first == start && *end == END && !leftLen && !rightLen)
+    {
+      // nothing left, remove the record
+      Coord* next = end + 1;
+      Shuffle(row, next, ptr - next);
+      return ptr;
+    }
+    int size = EncodedSize(leftLen) + EncodedSize(rightLen) - (end - start);
+    if (tableTop + size >= tableLimit)
+    {
+      error = eColumnFull;
+      STAT(stats.errors++);
+      return NextRow(ptr);
+    }
+    Shuffle(row, end, size);
+    Encode(start, leftCol, leftLen);
+    Encode(start + EncodedSize(leftLen), lastCol + 1, rightLen);
+    return NextRow(ptr);
+  }
+
+  void EraseRect(Coord firstRow, Coord lastRow, Coord firstCol, Coord lastCol)
+  {
+    // remove the pixels of every ink from the rectangle (INCLUSIVE), so a field of a retained band can be drawn again
+    lastCol = min(lastCol, DISPLAY_WIDTH - 1);
+    if (firstCol > lastCol)
+      return;
+    Flush();
+    Coord* ptr = FindRow(firstRow);
+    while (*ptr <= lastRow)
+      ptr = EraseRecord(ptr, firstCol, lastCol);
+    cursorRow = END;
+  }
+
+  void InkBits(Ink pixelInk, Coord row, Coord col, byte bits, Display::Colour clr)
+  {
+    // set the pixels from col (a multiple of 8) whose bit is set (MSB first) in the row buffer, as the ink colours them
+    if (pixelInk == InkBlack || pixelInk == InkBlackOver || pixelInk == InkRed)
+      Display::SetRowBufferBits(col, bits, clr);
+    else if (pixelInk == InkGrey)
+      Display::SetRowBufferBits(col, bits, Display::MonoGrey);
+    else
+    {
+      // dithered, alternate pixels are lighter, the odd cols on even rows & vice versa
+      byte alt = (row & 1) ? 0b10101010 : 0b01010101;
+      if (bits & ~alt)
+        Display::SetRowBufferBits(col, bits & ~alt, clr);
+      if (bits & alt)
+        Display::SetRowBufferBits(col, bits & alt, (pixelInk == InkDither) ? Display::MonoGrey : Display::MonoWhite);
+    }
+  }
+
+  void InkPixels(Ink pixelInk, Coord row, Coord col, Coord len, Display::Colour clr)
+  {
+    // set len pixels from col in the row buffer, as the ink colours them
+    if (pixelInk == InkBlack || pixelInk == InkBlackOver || pixelInk == InkRed)
+      Display::SetRowBufferAt(col, clr, len);
+    else if (pixelInk == InkGrey)
+      Display::SetRowBufferAt(col, Display::MonoGrey, len);
+    else
+    {
+      // dithered, 8 at a time
+      int last = col + len;
+      for (int group = col & ~7; group < last; group += 8)
+      {
+        byte bits = 0xFF;
+        if (group < col)
+          bits >>= col - group;
+        if (last < group + 8)
+          bits &= ~(0xFF >> (last - group));
+        InkBits(pixelInk, row, group, bits, clr);
+      }
+    }
+  }
+
+  Coord* ExpandRow(Coord* ptr, Display::Colour clr)
+  {
+    // set the record's pixels in the row buffer, if it's for clr's plane, returns the next record
+    Coord row = *ptr;
+    Ink recordInk = RecordInk(ptr);
+    if ((recordInk == InkRed) != (clr >= Display::ColourNone))
+      return NextRow(ptr);
+    ptr = RecordData(ptr);
+    if (*ptr == BITMAP)
+    {
+      // a byte at a time
+      byte* bits = (byte*)(ptr + 1);
+      for (int col = 0; col < DISPLAY_WIDTH; col += 8, bits++)
+        if (*bits)
+          InkBits(recordInk, row, col, *bits, clr);
+      return ptr + 1 + BITMAP_SIZE;
+    }
+    while (*ptr != END)
+    {
+      InkPixels(recordInk, row, *ptr, EntryLen(ptr), clr);
+      ptr = NextEntry(ptr);
+    }
+    return ptr + 1;
   }
 
-  void SendRows(byte firstRow, byte lastRow, Display::Colour foreground, Display::Colour background)
+  void SendRows(Coord firstRow, Coord lastRow, Display::Colour foreground, Display::Colour background)
   {
     // just send all the row data between startRow & endRow (INCLUSIVE), using the given colours
-    // sent after RuleCallback is called
+    // a red foreground sends the InkRed records, otherwise the rest, so the red plane can follow the last band
     // no Display::Start* function is called
-    byte* ptr = table;
+    Flush();
+    Coord* ptr = FindRow(firstRow); // skip earlier rows
     int currentRow = firstRow;
-    do
+    Display::FillRowBuffer(background);
+    while (*ptr <= lastRow)
     {
-      byte row = *ptr++;
-      if (row < firstRow)
-      {
-        // skip row
-        while (*ptr++ != END)
-          ;
-      }
-      else if (row <= lastRow)
+      Coord row = *ptr;
+      while (currentRow < row) // leading whole blank rows
       {
-        Display::FillRowBuffer(background);
-        while (currentRow < row) // leading whole blank rows
-        {
-          if (ruleCallback)
-          {
-            Display::FillRowBuffer(background);
-            ruleCallback(currentRow);
-          }
-          Display::SendRowBuffer();
-          currentRow++;
-        }
-        while (*ptr != END)
-        {
-          byte len = *(ptr + 1);
-          if (RUN_LEN_MIN <= len && len <= RUN_LEN_MAX)
-          {
-            // found a run, use it
-            len -= (RUN_LEN_MIN - RUN_LEN_LOW);
-            Display::SetRowBufferAt(*ptr, foreground, len);
-            ptr += 2;
-          }
-          else
-            Display::SetRowBufferAt(*ptr++, foreground);
-        }
-        if (ruleCallback)
-          ruleCallback(currentRow);
         Display::SendRowBuffer();
         currentRow++;
-        ptr++;
       }
-      else
-        break;
-    } while (true);
+      while (*ptr == row) // each ink
+        ptr = ExpandRow(ptr, foreground);
+      Display::SendRowBuffer();
+      Display::FillRowBuffer(background);
+      currentRow++;
+    }
 
     // trailing whole blank rows
-    Display::FillRowBuffer(background);
     while (currentRow <= lastRow)
     {
-      if (ruleCallback)
-      {
-        Display::FillRowBuffer(background);
-        ruleCallback(currentRow);
-      }
       Display::SendRowBuffer();
       currentRow++;
     }
-    tableHighWater = max(tableHighWater, tableTop);
+    tableHighWater = max(tableHighWater, tableTop + TABLE_ENTRIES - tableEnd);
   }
 
-  void Paint()
+  void Render(Coord firstRow, Coord lastRow, Display::Colour foreground, Display::Colour background, DrawCallback draw)
   {
-    byte* ptr = table;
-    byte currentRow = 0;
-    Display::StartMono();
-    do
+    // draw and send the rows between firstRow & lastRow (INCLUSIVE), in as many passes as it takes to fit them in the table
+    // draw is called for each pass and must draw everything in the band, the pixels outside the pass's rows are ignored
+    // on overflow the pass is halved and drawn again
+    Coord first = firstRow;
+    Coord last = lastRow;
+    while (first <= lastRow)
     {
-      byte row = *ptr++;
-      if (row != END)
+      Clear(first);
+      windowFirst = first;
+      windowLast = min(last, drawLast);
+      draw();
+      Flush();
+      if (error && last > first)
+        last = first + (last - first)/2;
+      else
       {
-        Display::FillRowBuffer(COLOUR_BACK);
-        currentRow++;
-        while (currentRow < row) // leading whole blank rows
-        {
-          currentRow++;
-          Display::SendRowBuffer();
-        }
-        while (*ptr != END)
+        SendRows(first, last, foreground, background);
+        first = last + 1;
+        last = lastRow;
+      }
+    }
+    windowFirst = 0;
+    windowLast = drawLast;
+  }
+
+  bool HasRed()
+  {
+    return redRecords;
+  }
+
+  void Dump()
+  {
+    // print the records, one per line with their cols & runs, then the stats since the last Dump
+    Flush();
+    Serial.print("SparseInk from row ");
+    Serial.print(dirBase);
+    Serial.print(", ");
+    Serial.print(tableTop*sizeof(Coord));
+    if (tableEnd < TABLE_ENTRIES)
+    {
+      Serial.print(" + ");
+      Serial.print((TABLE_ENTRIES - tableEnd)*sizeof(Coord));
+      Serial.print(" parked");
+    }
+    Serial.print('/');
+    Serial.print(TABLE_SIZE);
+    Serial.println(" bytes");
+    for (Coord* ptr = table; *ptr != END; ptr = NextRow(ptr))
+    {
+      Serial.print(*ptr);
+      if (RecordInk(ptr) != InkBlack)
+      {
+        Serial.print(" ink ");
+        Serial.print(RecordInk(ptr));
+      }
+      Serial.print(':');
+      Coord* entry = RecordData(ptr);
+      if (*entry == BITMAP)
+        Serial.print(" bitmap");
+      else
+        for (; *entry != END; entry = NextEntry(entry))
         {
-          byte len = *(ptr + 1);
-          if (RUN_LEN_MIN <= len && len <= RUN_LEN_MAX)
+          Serial.print(' ');
+          Serial.print(*entry);
+          if (EntryLen(entry) > 1)
           {
-            // found a run, use it
-            len -= (RUN_LEN_MIN - RUN_LEN_LOW);
-            Display::SetRowBufferAt(*ptr, COLOUR_FORE, len);
-            ptr += 2;
+            Serial.print('-');
+            Serial.print(*entry + EntryLen(entry) - 1);
           }
-          else
-            Display::SetRowBufferAt(*ptr++, COLOUR_FORE);
         }
-        Display::SendRowBuffer();
-        ptr++;
-      }
-      else
-        break;
-    } while (true);
+      Serial.print(" (");
+      Serial.print((NextRow(ptr) - ptr)*sizeof(Coord));
+      Serial.println(" bytes)");
+    }
+#ifdef SPARSEINK_STATS
+    Serial.print("lookups ");
+    Serial.print(stats.lookups);
+    Serial.print(", cursor hits ");
+    Serial.print(stats.cursorHits);
+    Serial.print(", row steps ");
+    Serial.print(stats.rowSteps);
+    Serial.print(", col steps ");
+    Serial.print(stats.colSteps);
+    Serial.print(", bytes moved ");
+    Serial.println(stats.bytesMoved);
+    Serial.print("inserts ");
+    Serial.print(stats.inserts);
+    Serial.print(", duplicates ");
+    Serial.print(stats.duplicates);
+    Serial.print(", errors ");
+    Serial.print(stats.errors);
+    Serial.print(", flushes ");
+    Serial.print(stats.flushes);
+    Serial.print(", peak ");
+    Serial.println(stats.peak);
+    ::memset(&stats, 0, sizeof(stats));
+#endif
+  }
 
-    // trailing whole blank rows
-    Display::FillRowBuffer(COLOUR_BACK);
-    while (currentRow < DISPLAY_HEIGHT)
+  void Paint()
+  {
+    // send the whole table as a frame
+    Display::StartMono();
+    SendRows(0, DISPLAY_HEIGHT - 1, COLOUR_FORE, COLOUR_BACK);
+    if (HasRed())
     {
-      currentRow++;
-      Display::SendRowBuffer();
+      Display::StartRed();
+      SendRows(0, DISPLAY_HEIGHT - 1, Display::ColourRed, Display::ColourNone);
     }
-    Display::StartRed();
-    Display::FillRowBuffer(Display::ColourNone);
-    for (int row = 0; row < DISPLAY_HEIGHT; row++)
-      Display::SendRowBuffer();
+    else
+      Display::SendBlankRed();
     Display::Refresh();
   }
 
@@ -1,19 +1,53 @@
 #pragma once
 
 // Virtual, compressed frame buffer
+
+// optionally count lookups etc, to see where the time goes:
+//#define SPARSEINK_STATS
+
+// Pixel logs the pixels and sorts them into the table in batches (vs inserting each in order), see Flush
+//#define SPARSEINK_BATCH
+
 namespace SparseInk
 {
-  typedef void (*RuleCallback)(int row);
-  enum Error {eNone = 0, eRowFull, eColumnFull, ePacked};
+  typedef void (*DrawCallback)();
+  enum Error {eNone = 0, eRowFull, eColumnFull};
+  // how a pixel is coloured when it's sent. the dithered inks lighten alternate pixels (pure grey is very faint!)
+  // where inks overlap, the later one in this list wins, so InkBlackOver is black over everything
+  // InkRed pixels are on the red plane, sent after all the mono bands (Clear keeps them), see SendRows
+  enum Ink {InkBlack = 0, InkDither, InkDitherLight, InkGrey, InkBlackOver, InkRed};
+  // rows & cols, and the table's entries. a byte up to 200x200 (the table's codes take 200..255), wider for bigger panels
+#if DISPLAY_WIDTH <= 200 && DISPLAY_HEIGHT <= 200
+  typedef byte Coord;
+#else
+  typedef uint16_t Coord;
+#endif
 
-  void Clear();
-  void Dump();
-  void Pixel(byte row, byte col);
-  int Pack();
-  void SetRuleCallback(RuleCallback func);
-  void SendRows(byte firstRow, byte lastRow, Display::Colour foreground, Display::Colour background);
+  void Clear(Coord firstRow = 0); // firstRow is the top of the band about to be drawn, red pixels above it are kept
+  void Dump(); // print the table's records (and stats) over Serial
+  void Pixel(Coord row, Coord col);
+  void Span(Coord row, Coord col, Coord len); // a horizontal line of pixels
+  void SetInk(Ink ink); // for the following Pixels & Spans
+  void Flush(); // with SPARSEINK_BATCH, add the logged Pixels to the table, so error is up to date
+  void Retain(Coord firstRow, Coord lastRow); // Clear keeps these rows, drawing into them from a band above is ignored
+  void Release(); // until this
+  void EraseRect(Coord firstRow, Coord lastRow, Coord firstCol, Coord lastCol); // INCLUSIVE
+  void SendRows(Coord firstRow, Coord lastRow, Display::Colour foreground, Display::Colour background);
+  bool HasRed(); // there may be InkRed pixels, else the red plane is blank, see Display::SendBlankRed
+  void Render(Coord firstRow, Coord lastRow, Display::Colour foreground, Display::Colour background, DrawCallback draw);
   void Paint();
 
-  extern int tableHighWater;
+  extern int tableHighWater; // in Coords
   extern Error error;
+#ifdef SPARSEINK_STATS
+  struct Stats
+  {
+    unsigned long lookups, cursorHits; // column searches, and those started from the cursor
+    unsigned long rowSteps, colSteps;  // records & entries stepped over while searching
+    unsigned long bytesMoved;          // shuffling the table
+    unsigned int inserts, duplicates, errors, flushes;
+    int peak;                          // highest tableTop
+  };
+  extern Stats stats; // since the last Dump
+#endif
 };
@@ -7,6 +7,8 @@
 #include <pocketBME280.h>
 #endif
 #include "Display.h"
+#include "SparseInk.h"
+#include "Arena.h"
 #include "Sensor.h"
 #include "Page.h"
 
@@ -66,10 +68,13 @@
 void setup() 
 {
   Sensor::Init(); // start it taking readings early
-#if defined(DEBUG) || defined(DISPLAY_SERIALIZE)  
+#if defined(DEBUG) || defined(DISPLAY_SERIALIZE) || defined(SPARSEINK_STATS)
   Serial.begin(38400);
   Serial.println("WeatherStationery");
 #endif  
+#ifdef SPARSEINK_STATS
+  Arena::Report();
+#endif
   Page::Init();
 #ifndef DEBUG
   Page::Splash(); 
@@ -0,0 +1,67 @@
+#pragma once
+// Just enough of Arduino.h to build the sketch's sources on a PC, see host.cpp
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <stdio.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define pgm_read_byte_near(_p) (*(const uint8_t*)(_p))
+#define pgm_read_byte(_p) (*(const uint8_t*)(_p))
+#define pgm_read_word_near(_p) (*(const uint16_t*)(_p))
+// a pointer read from PROGMEM converts to any pointer type, as avr-gcc's -fpermissive lets the void* returned do
+struct PgmPtr
+{
+  const void* ptr;
+  template <class T> operator T*() const { return (T*)ptr; }
+};
+#define pgm_read_ptr_near(_p) (PgmPtr{*(const void* const*)(_p)})
+#define strcpy_P strcpy
+#define strcat_P strcat
+#define strlen_P strlen
+#define memcpy_P memcpy
+#define F(_s) _s
+
+// include any std headers before this, these break them
+#define min(_a, _b) ((_a) < (_b) ? (_a) : (_b))
+#define max(_a, _b) ((_a) > (_b) ? (_a) : (_b))
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define HEX 16
+#define A0 14
+#define A1 15
+
+inline char* itoa(int value, char* buffer, int) { sprintf(buffer, "%d", value); return buffer; }
+long random(long from, long to);
+void randomSeed(unsigned long seed);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+unsigned long millis();
+unsigned long micros();
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+
+struct HardwareSerial
+{
+  void begin(long) {}
+  void print(const char* str) { fputs(str, stdout); }
+  void print(char ch) { putchar(ch); }
+  void print(long value, int base = 10) { printf(base == HEX ? "%lX" : "%ld", value); }
+  void print(unsigned long value, int base = 10) { printf(base == HEX ? "%lX" : "%lu", value); }
+  void print(int value, int base = 10) { print((long)value, base); }
+  void print(unsigned int value, int base = 10) { print((unsigned long)value, base); }
+  void print(byte value, int base = 10) { print((unsigned long)value, base); }
+  template <class T> void println(T value) { print(value); println(); }
+  template <class T> void println(T value, int base) { print(value, base); println(); }
+  void println() { putchar('\n'); }
+};
+extern HardwareSerial Serial;
@@ -0,0 +1,19 @@
+#pragma once
+#include <Arduino.h>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+struct SPISettings
+{
+  SPISettings(long, int, int) {}
+};
+
+struct SPIClass
+{
+  void begin() {}
+  void beginTransaction(SPISettings) {}
+  void endTransaction() {}
+  uint8_t transfer(uint8_t data); // see host.cpp
+};
+extern SPIClass SPI;
@@ -0,0 +1,13 @@
+#pragma once
+#include <Arduino.h>
+
+struct TwoWire
+{
+  void begin() {}
+  void beginTransmission(int) {}
+  void write(int) {}
+  int endTransmission() { return 0; }
+  int requestFrom(int, int) { return 1; }
+  int read() { return 0; }
+};
+extern TwoWire Wire;
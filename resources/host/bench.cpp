@@ -0,0 +1,506 @@
+// Benchmarks SparseInk on the PC, replaying the pixels the sketch draws, and checks every band it sends
+// against a plain bitmap. See readme.txt
+//   bench [passes]
+#include <chrono>
+#include <Arduino.h>
+#include "Display.h"
+#include "SparseInk.h"
+#include "StrokedFont.h"
+#include "Graphics.h"
+#include "Page.h"
+#include "Arena.h"
+#include "host.h"
+
+namespace Page
+{
+  void Paint(int pressure_hPa, char forecastLetter, char pressureTrend, int temperature_C, int humidity_Percent);
+}
+
+#define MAX_OPS 100000
+Host::Op ops[MAX_OPS];
+int numOps = 0;
+
+// the reference, the ink+1 of each pixel (0 if none), the larger ink wins, and the red plane, kept until a Clear above it
+byte dense[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+bool denseRed[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+
+// the rows SparseInk is retaining, and the last it draws in, as it works them out
+int retainFirst = DISPLAY_HEIGHT, retainLast = -1, drawLast = DISPLAY_HEIGHT - 1;
+
+// the band being replayed, and the ink at its start
+int bandStart = 0, bandEnd = 0;
+byte bandInk = SparseInk::InkBlack;
+byte ink = SparseInk::InkBlack;
+
+// Run sends the bands as one frame, each plane started once, as Page does, rather than each band from row 0
+bool wholeFrame = false;
+
+void Replay(int from, int to, bool reference)
+{
+  // replay ops [from, to), just the drawing, into SparseInk and optionally the reference
+  for (int i = from; i < to; i++)
+  {
+    const Host::Op& op = ops[i];
+    switch (op.kind)
+    {
+      case Host::OpInk:
+        ink = op.col;
+        SparseInk::SetInk((SparseInk::Ink)ink);
+        break;
+      case Host::OpPixel:
+        SparseInk::Pixel(op.row, op.col);
+        break;
+      case Host::OpSpan:
+        SparseInk::Span(op.row, op.col, op.len);
+        break;
+      case Host::OpErase:
+        SparseInk::EraseRect(op.row, op.last, op.col, op.col + op.len - 1);
+        if (reference)
+          for (int row = op.row; row <= op.last && row < DISPLAY_HEIGHT; row++)
+            for (int col = op.col; col < op.col + op.len && col < DISPLAY_WIDTH; col++)
+              dense[row][col] = denseRed[row][col] = 0;
+        break;
+    }
+    if (reference && (op.kind == Host::OpPixel || op.kind == Host::OpSpan) && op.row <= drawLast)
+      for (int col = op.col; col < op.col + op.len && col < DISPLAY_WIDTH && op.row < DISPLAY_HEIGHT; col++)
+      {
+        if (ink == SparseInk::InkRed)
+          denseRed[op.row][col] = true;
+        else
+          dense[op.row][col] = max(dense[op.row][col], ink + 1);
+      }
+  }
+}
+
+void ReplayBand()
+{
+  // SparseInk::Render callback
+  ink = bandInk;
+  SparseInk::SetInk((SparseInk::Ink)ink);
+  Replay(bandStart, bandEnd, false);
+}
+
+Display::Colour Expected(int row, int col, Display::Colour foreground, Display::Colour background)
+{
+  // what SparseInk should send for the pixel, from the reference
+  if (foreground >= Display::ColourNone)
+    return denseRed[row][col] ? foreground : background;
+  int odd = (row ^ col) & 1;
+  switch (dense[row][col])
+  {
+    case 0:                             return background;
+    case 1 + SparseInk::InkDither:      return odd ? Display::MonoGrey : foreground;
+    case 1 + SparseInk::InkDitherLight: return odd ? Display::MonoWhite : foreground;
+    case 1 + SparseInk::InkGrey:        return Display::MonoGrey;
+    default:                            return foreground;
+  }
+}
+
+int CheckBand(const Host::Op& send)
+{
+  // compare what was sent with the reference, returns the number of pixels which differ
+  bool redPlane = send.foreground >= Display::ColourNone;
+  int diffs = 0;
+  for (int row = send.row; row <= send.col; row++)
+    for (int col = 0; col < DISPLAY_WIDTH; col++)
+    {
+      int sent = row - send.row;
+      Display::Colour clr;
+      if (redPlane)
+        clr = (Host::red[sent][col >> 3] & (0b10000000 >> (col & 7))) ? Display::ColourNone : Display::ColourRed;
+      else
+      {
+        byte bits = (Host::mono[sent][col >> 2] >> (6 - 2*(col & 3))) & 0b11;
+        clr = (bits == 0b00) ? Display::MonoBlack : (bits == 0b10) ? Display::MonoGrey : Display::MonoWhite;
+      }
+      Display::Colour expected = Expected(row, col, (Display::Colour)send.foreground, (Display::Colour)send.background);
+      if (clr != expected && diffs++ < 3)
+        printf("  row %d col %d sent %d expected %d\n", row, col, clr, expected);
+    }
+  return diffs;
+}
+
+struct Result
+{
+  unsigned long inserts, bands, overflows, diffs;
+  unsigned long bytesMoved;
+  int peak;
+  double drawSeconds, sendSeconds;
+};
+
+void Run(Result& result, bool check)
+{
+  // replay the recorded ops into SparseInk, sending each band, and checking it if asked
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+  bandStart = 0;
+  SparseInk::Release(); // nothing kept from the last run
+  SparseInk::Clear();
+  retainFirst = DISPLAY_HEIGHT;
+  retainLast = -1;
+  ink = SparseInk::InkBlack;
+  SparseInk::SetInk(SparseInk::InkBlack);
+  bool monoStarted = false, redStarted = false;
+  for (int i = 0; i < numOps; i++)
+  {
+    const Host::Op& op = ops[i];
+    if (op.kind == Host::OpClear)
+    {
+      SparseInk::Clear(op.row);
+      bandStart = i + 1;
+      bandInk = ink;
+      if (check)
+        for (int row = 0; row < DISPLAY_HEIGHT; row++)
+          if (row < retainFirst || row > retainLast)
+          {
+            ::memset(dense[row], 0, sizeof(dense[0]));
+            if (row >= op.row)
+              ::memset(denseRed[row], 0, sizeof(denseRed[0]));
+          }
+      drawLast = (op.row < retainFirst && retainFirst <= retainLast) ? retainFirst - 1 : DISPLAY_HEIGHT - 1;
+    }
+    else if (op.kind == Host::OpSend)
+    {
+      bandEnd = i;
+      Display::Colour foreground = (Display::Colour)op.foreground, background = (Display::Colour)op.background;
+      if (foreground >= Display::ColourNone)
+      {
+        if (!wholeFrame || !redStarted)
+          Display::StartRed();
+        redStarted = true;
+      }
+      else if (!wholeFrame || !monoStarted)
+        Display::StartMono();
+      monoStarted = true;
+      SparseInk::Flush(); // the batch's inserts are drawing
+      Clock::time_point sendStart = Clock::now();
+      result.drawSeconds += std::chrono::duration<double>(sendStart - start).count();
+      if (SparseInk::error)
+      {
+        result.overflows++;
+        SparseInk::Render(op.row, op.col, foreground, background, ReplayBand);
+      }
+      else
+        SparseInk::SendRows(op.row, op.col, foreground, background);
+      Display::Drain(); // the last row, with DISPLAY_SPI_ISR
+      start = Clock::now();
+      result.sendSeconds += std::chrono::duration<double>(start - sendStart).count();
+      result.bands++;
+      if (check)
+        result.diffs += CheckBand(op);
+    }
+    else if (op.kind == Host::OpRetain)
+    {
+      SparseInk::Retain(op.row, op.col);
+      retainFirst = op.row;
+      retainLast = op.col;
+    }
+    else if (op.kind == Host::OpRelease)
+    {
+      SparseInk::Release();
+      retainFirst = DISPLAY_HEIGHT;
+      retainLast = -1;
+    }
+    else
+    {
+      if (op.kind == Host::OpPixel || op.kind == Host::OpSpan)
+        result.inserts++;
+      Replay(i, i + 1, check);
+    }
+  }
+#ifdef SPARSEINK_STATS
+  result.bytesMoved += SparseInk::stats.bytesMoved;
+  result.peak = max(result.peak, SparseInk::stats.peak);
+  ::memset(&SparseInk::stats, 0, sizeof(SparseInk::stats));
+#endif
+  if (wholeFrame && !redStarted)
+    Display::SendBlankRed();
+}
+
+int passes = 100;
+bool Report(const char* name)
+{
+  // check the recorded ops, then time them, returns false if they didn't match the reference
+  if (numOps > MAX_OPS)
+  {
+    printf("%-14s too many ops, %d\n", name, numOps);
+    return false;
+  }
+  Result checked = {}, timed = {};
+  ::memset(&Display::stats, 0, sizeof(Display::stats));
+  Run(checked, true);
+  Display::Stats sent = Display::stats;
+  for (int pass = 0; pass < passes; pass++)
+    Run(timed, false);
+  double draw = timed.drawSeconds/passes, send = timed.sendSeconds/passes;
+  printf("%-14s %5lu %7lu %4lu %9.1f %9.2f %9.1f %9lu %5d %7lu %7lu %s\n",
+         name, checked.bands, checked.inserts, checked.overflows,
+         1e6*draw, checked.inserts/draw/1e6, 1e6*send, checked.bytesMoved, checked.peak,
+         sent.bytes, sent.selects, checked.diffs ? "DIFF" : "ok");
+  return !checked.diffs;
+}
+
+void RecordBand(int maxRow, int firstRow = 0)
+{
+  // after some drawing, send the rows it used
+  Host::Record(Host::OpSend, firstRow, min(maxRow, DISPLAY_HEIGHT - 1), 0, Display::MonoBlack, Display::MonoWhite);
+}
+
+int MaxRow(int from)
+{
+  int maxRow = 0;
+  for (int i = from; i < Host::numOps; i++)
+    if (ops[i].kind == Host::OpPixel || ops[i].kind == Host::OpSpan)
+      maxRow = max(maxRow, ops[i].row);
+  return maxRow;
+}
+
+bool CheckRefresh()
+{
+  // a refresh then sleep in the background, Poll must only move on as BUSY's released, and nothing's sent while it's low
+  Display::Init();
+  Display::BeginRefresh();
+  Display::BeginSleep();
+  int polls = 0;
+  while (!Display::Poll())
+  {
+    delay(100);
+    polls++;
+  }
+  bool ok = !Host::busyBytes && Host::asleep && polls >= (int)(REFRESH_MICROS/100000);
+  printf("%-14s %d polls, %lu bytes while busy, %s %s\n", "refresh", polls, Host::busyBytes, Host::asleep ? "asleep" : "awake",
+         ok ? "ok" : "FAIL");
+  return ok;
+}
+
+bool CheckWake()
+{
+  // Init after Sleep only powers the panel back on, it must leave it set up just as a whole Init does
+  Display::Sleep();
+  Display::Reset(); // forget the settings & LUTs, so the next Init is a whole one
+  unsigned long micros0 = micros(), bytes = Host::spiBytes;
+  Display::Init();
+  unsigned long coldMicros = micros() - micros0, coldBytes = Host::spiBytes - bytes;
+  static uint16_t registers[256];
+  ::memcpy(registers, Host::registers, sizeof(registers));
+  Display::Sleep();
+  micros0 = micros();
+  bytes = Host::spiBytes;
+  Display::Init();
+  unsigned long warmMicros = micros() - micros0, warmBytes = Host::spiBytes - bytes;
+  bool ok = !::memcmp(registers, Host::registers, sizeof(registers)) && !Host::asleep;
+  printf("%-14s cold %lu ms %lu bytes, warm %lu ms %lu bytes (in delays, to the first pixel byte), %s\n", "wake",
+         coldMicros/1000, coldBytes, warmMicros/1000, warmBytes, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+#ifdef DISPLAY_LUT_PROFILES
+bool CheckLUTs()
+{
+  // ChooseLUTs' policy, and how long each profile's refresh takes (from host.cpp's LUT frames)
+  bool ok = Display::ChooseLUTs(-5, true, 0) == Display::LUTFreezing &&
+            Display::ChooseLUTs(5, true, 0) == Display::LUTCold &&
+            Display::ChooseLUTs(35, true, 0) == Display::LUTHot &&
+            Display::ChooseLUTs(20, false, 0) == Display::LUTNormal &&
+            Display::ChooseLUTs(20, true, 0) == Display::LUTFast;
+  // small changes at room temperature, a full refresh every LUT_FULL_EVERY, as Page::Wake counts them
+  int fastSinceFull = 0, full = 0;
+  for (int page = 0; page < 3*LUT_FULL_EVERY; page++)
+  {
+    Display::LUTProfile luts = Display::ChooseLUTs(20, true, fastSinceFull);
+    fastSinceFull = (luts == Display::LUTFast) ? fastSinceFull + 1 : 0;
+    full += luts != Display::LUTFast;
+  }
+  ok &= full == 3;
+  printf("%-14s", "luts");
+  const char* names[] = {"freezing", "cold", "normal", "hot", "fast"};
+  unsigned long last = 0, initBytes = 0;
+  for (int profile = Display::LUTFreezing; profile <= Display::LUTFast; profile++)
+  {
+    // a whole Init sends the profile's LUTs, once, in place of the panel's own
+    Display::SetLUTs((Display::LUTProfile)profile);
+    unsigned long bytes = Host::spiBytes;
+    Display::Init();
+    bytes = Host::spiBytes - bytes;
+    ok &= !initBytes || bytes == initBytes;
+    initBytes = bytes;
+    unsigned long start = micros();
+    Display::Refresh();
+    unsigned long refresh = micros() - start;
+    ok &= !last || refresh < last; // each shorter
+    ok &= profile != Display::LUTNormal || refresh >= REFRESH_MICROS;
+    last = refresh;
+    printf(" %s %.1fs", names[profile], refresh/1e6);
+  }
+  // a warm Init sends them only if they're not the ones loaded
+  unsigned long bytes[2];
+  for (int i = 0; i < 2; i++)
+  {
+    Display::Sleep();
+    Display::SetLUTs(i ? Display::LUTNormal : Display::LUTFast);
+    bytes[i] = Host::spiBytes;
+    Display::Init();
+    bytes[i] = Host::spiBytes - bytes[i];
+  }
+  ok &= bytes[1] - bytes[0] == 8*(1 + 15);
+  printf(", %d full of %d, Init %lu bytes, warm %lu/%lu, %s\n", full, 3*LUT_FULL_EVERY, initBytes, bytes[0], bytes[1],
+         ok ? "ok" : "FAIL");
+  return ok;
+}
+#endif
+
+#if defined(DISPLAY_PARTIAL) && DISPLAY_WIDTH == 200 && DISPLAY_HEIGHT == 200
+// two pages, differing in the humidity, recorded before any are sent as recording draws them on the panel too
+Host::Op pages[3][MAX_OPS];
+int pageOps[3];
+
+void SendPage(int page)
+{
+  // a recorded page, sent as a frame & refreshed
+  ::memcpy(ops, pages[page], pageOps[page]*sizeof(Host::Op));
+  numOps = pageOps[page];
+  wholeFrame = true;
+  Result result = {};
+  Run(result, false);
+  wholeFrame = false;
+  Display::Refresh();
+}
+
+bool CheckPartial(char forecastLetter)
+{
+  // a page, then one with the humidity changed, drawn twice as Page::Loop does, hashed to find the rows which changed,
+  // then sent & refreshed in a window. the panel must end up as if the second was sent whole
+  // with a '?' forecast the letter's random, it must be the same in both (it's picked once per update)
+  for (int page = 0; page < 3; page++)
+  {
+    Host::StartRecording(pages[page], MAX_OPS);
+    Page::Paint(1013, forecastLetter, 'S', 21, page ? 49 : 48);
+    pageOps[page] = min(Host::numOps, MAX_OPS);
+  }
+  Display::Init();
+  SendPage(0);
+  Display::StartHashing();
+  SendPage(1);
+  int first, last;
+  bool changed = Display::EndHashing(first, last);
+  Display::Init();
+  Display::StartWindow(first, last);
+  unsigned long bytes = Host::spiBytes, rows = Host::rowsRefreshed;
+  SendPage(2);
+  bytes = Host::spiBytes - bytes;
+  rows = Host::rowsRefreshed - rows;
+  static byte mono[DISPLAY_HEIGHT][DISPLAY_WIDTH/4], red[DISPLAY_HEIGHT][DISPLAY_WIDTH/8];
+  ::memcpy(mono, Host::mono, sizeof(mono));
+  ::memcpy(red, Host::red, sizeof(red));
+  Host::ClearPanel();
+  Display::Init();
+  unsigned long wholeBytes = Host::spiBytes;
+  SendPage(2);
+  wholeBytes = Host::spiBytes - wholeBytes;
+  bool same = !::memcmp(mono, Host::mono, sizeof(mono)) && !::memcmp(red, Host::red, sizeof(red));
+  bool ok = changed && same && !Host::partialIn && last - first + 1 <= DISPLAY_HEIGHT/2;
+  printf("%-14s forecast %c, rows %d-%d, %lu refreshed, %lu bytes (whole page %lu), %s %s\n", "partial", forecastLetter,
+         first, last, rows, bytes, wholeBytes, same ? "same" : "differs", ok ? "ok" : "FAIL");
+  return ok;
+}
+#endif
+
+int main(int argc, char** argv)
+{
+  if (argc > 1)
+    passes = max(atoi(argv[1]), 1);
+  Host::ClearPanel();
+  Page::Init();
+  bool ok = true;
+  Arena::Report();
+  printf("%-14s %5s %7s %4s %9s %9s %9s %9s %5s %7s %7s\n", "stream", "bands", "inserts", "over", "draw us", "M ins/s", "send us", "moved", "peak",
+         "spi", "selects");
+
+  // each glyph in a band of its own
+  const int scales[2][2] = {{1, 1}, {5, 2}};
+  for (int scale = 0; scale < 2; scale++)
+  {
+    Host::StartRecording(ops, MAX_OPS);
+    for (int ch = 1; ch <= 0xB0; ch++) // to <degrees>, the font's last, it has no end marker
+    {
+      int from = Host::numOps;
+      Host::Record(Host::OpClear, 0, 0);
+      StrokedFont::DrawChar(10, 10, (char)ch, scales[scale][0], scales[scale][1]);
+      if (Host::numOps == from + 1)
+        Host::numOps = from; // not a glyph
+      else
+        RecordBand(MaxRow(from));
+    }
+    numOps = Host::numOps;
+    char name[32];
+    sprintf(name, "glyphs %d/%d", scales[scale][0], scales[scale][1]);
+    ok &= Report(name);
+  }
+
+  // each icon in a band of its own
+  Host::StartRecording(ops, MAX_OPS);
+  for (int icon = 0; icon < Graphics::NumWeatherIcons; icon++)
+  {
+    int from = Host::numOps;
+    Host::Record(Host::OpClear, 0, 0);
+    Graphics::Weather(20, 10, icon);
+    RecordBand(MaxRow(from));
+  }
+  numOps = Host::numOps;
+  ok &= Report("icons");
+
+  // lines of text filling the panel, a band per line, to exercise its whole width & height
+  // the first char in red, kept by SparseInk through the later bands until the red plane is sent after the last
+  Host::StartRecording(ops, MAX_OPS);
+  const int lineHeight = StrokedFont::Height(5, 2) + 2;
+  char ch = '0';
+  for (int top = 0; top + lineHeight <= DISPLAY_HEIGHT; top += lineHeight)
+  {
+    int from = Host::numOps;
+    Host::Record(Host::OpClear, top, 0);
+    for (int x = 0; x < DISPLAY_WIDTH; x = StrokedFont::cursorX)
+    {
+      Host::Record(Host::OpInk, 0, (x || top) ? SparseInk::InkBlack : SparseInk::InkRed);
+      StrokedFont::DrawChar(x, top, ch, 5, 2);
+      ch = (ch == 'Z') ? '0' : ch + 1;
+    }
+    RecordBand(max(MaxRow(from), top), top);
+  }
+  Host::Record(Host::OpClear, DISPLAY_HEIGHT, 0);
+  Host::Record(Host::OpSend, 0, DISPLAY_HEIGHT - 1, 0, Display::ColourRed, Display::ColourNone);
+  numOps = Host::numOps;
+  ok &= Report("text");
+
+#if DISPLAY_WIDTH == 200 && DISPLAY_HEIGHT == 200
+  // the whole page, as Page draws it, its layout is for this size
+  Host::StartRecording(ops, MAX_OPS);
+  Page::Splash();
+  numOps = Host::numOps;
+  ok &= Report("splash");
+  const char letters[] = {'A', 'F', 'K', 'P', 'U', 'Z', '?'};
+  const char trends[] = {'S', 'R', 'F', 'S', 'R', 'F', '?'};
+  Host::StartRecording(ops, MAX_OPS);
+  for (int i = 0; i < 7; i++)
+    Page::Paint(990 + i*7, letters[i], trends[i], -5 + i*7, (i == 6) ? -1 : 30 + i*11);
+  numOps = Host::numOps;
+  ok &= Report("pages");
+  // pages which differ by a digit or two, as most do
+  Host::StartRecording(ops, MAX_OPS);
+  for (int i = 0; i < 7; i++)
+    Page::Paint(1013, 'F', 'S', 21 + i/3, 48 + i);
+  numOps = Host::numOps;
+  ok &= Report("page edits");
+#endif
+
+  ok &= CheckRefresh();
+  ok &= CheckWake();
+#ifdef DISPLAY_LUT_PROFILES
+  ok &= CheckLUTs();
+#endif
+#if defined(DISPLAY_PARTIAL) && DISPLAY_WIDTH == 200 && DISPLAY_HEIGHT == 200
+  ok &= CheckPartial('F');
+  ok &= CheckPartial('?');
+#endif
+  printf(ok ? "all bands match\n" : "MISMATCH\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Builds bench (see readme.txt) with the PC's C++ compiler, run from this folder
+# the sources which draw are built against recorder.cpp, which stands in for SparseInk
+# then panel, with them drawing into SparseInk itself (without its dumps)
+SRC=../..
+CXX="${CXX:-g++} -O2 -std=gnu++17 -Wall -fpermissive -DARDUINO_AVR_UNO -DSPARSEINK_STATS -DDISPLAY_STATS $CXXFLAGS -I. -I$SRC"
+mkdir -p obj
+for f in Graphics Page Sensor StrokedFont Weather; do
+  $CXX -DSparseInk=Recorder -c $SRC/$f.cpp -o obj/$f.o || exit 1
+done
+$CXX -DSparseInk=Recorder -c recorder.cpp -o obj/recorder.o || exit 1
+for f in Arena Display SparseInk; do
+  $CXX -c $SRC/$f.cpp -o obj/$f.o || exit 1
+done
+$CXX -c host.cpp -o obj/host.o || exit 1
+$CXX -c bench.cpp -o obj/bench.o || exit 1
+$CXX -o bench obj/*.o
+mkdir -p obj/panel
+for f in Graphics Page Sensor StrokedFont Weather; do
+  $CXX -USPARSEINK_STATS -c $SRC/$f.cpp -o obj/panel/$f.o || exit 1
+done
+$CXX -c panel.cpp -o obj/panel/panel.o || exit 1
+$CXX -o panel obj/panel/*.o obj/Arena.o obj/Display.o obj/SparseInk.o obj/host.o
@@ -0,0 +1,184 @@
+// The Arduino functions the sketch's sources use, and a virtual panel which keeps what's sent over SPI
+#include <Arduino.h>
+#include <SPI.h>
+#include <Wire.h>
+#include "Pins.h"
+#include "host.h"
+
+HardwareSerial Serial;
+SPIClass SPI;
+TwoWire Wire;
+
+namespace Host
+{
+  unsigned long microsNow = 0; // time only passes in delays
+  int pinValues[64];
+
+  byte mono[DISPLAY_HEIGHT][DISPLAY_WIDTH/4];
+  byte red[DISPLAY_HEIGHT][DISPLAY_WIDTH/8];
+  int frames = 0;
+  unsigned long spiBytes = 0;
+  byte* plane = nullptr; // where data goes, after a data start command
+  size_t planeSize = 0, planePos = 0;
+  unsigned long busyUntil = 0; // BUSY is low (busy) until then, after a refresh command
+  unsigned long busyBytes = 0;
+  bool asleep = false;
+  byte command = 0; // the last, and the data bytes since
+  int param = 0;
+  bool partialIn = false; // the planes & refresh are just the window's rows
+  int windowFirst = 0, windowLast = DISPLAY_HEIGHT - 1;
+  unsigned long rowsRefreshed = 0;
+  uint16_t registers[256];
+  byte luts[8][15]; // lut_vcom0 (0x20) to lut_red1 (0x27), all 0 for the panel's own, after a reset
+#define LUT_FRAMES 927 // in the panel's own, pLUTData's, which take REFRESH_MICROS
+  const char* imagePrefix = nullptr;
+  unsigned long pinWrites = 0, busyMicros = 0;
+
+  void StartPlane(byte* data, size_t size)
+  {
+    plane = data;
+    planeSize = size;
+    planePos = 0;
+  }
+
+  void ClearPanel()
+  {
+    ::memset(mono, 0xFF, sizeof(mono));
+    ::memset(red, 0xFF, sizeof(red));
+  }
+
+  unsigned long RefreshMicros()
+  {
+    // from the LUTs' frames, the vcom ones have all the phases, mono's then red's
+    unsigned long long frames = 0;
+    for (int lut = 0; lut <= 5; lut += 5) // lut_vcom0 & lut_vcom1
+      for (int group = 0; group < 15; group += 3)
+        frames += ((luts[lut][group] & 0x3F) + (luts[lut][group + 1] & 0x3F))*luts[lut][group + 2];
+    return frames ? frames*REFRESH_MICROS/LUT_FRAMES : REFRESH_MICROS;
+  }
+
+  Display::Colour Pixel(int row, int col)
+  {
+    // the panel's colour at row, col, red over mono
+    if (!(red[row][col >> 3] & (0b10000000 >> (col & 7))))
+      return Display::ColourRed;
+    switch ((mono[row][col >> 2] >> (6 - 2*(col & 3))) & 0b11)
+    {
+      case 0b00: return Display::MonoBlack;
+      case 0b10: return Display::MonoGrey;
+      default:   return Display::MonoWhite;
+    }
+  }
+
+  void WriteImage(const char* path)
+  {
+    // the panel as a PPM, red over the mono greys
+    FILE* file = fopen(path, "wb");
+    if (!file)
+      return;
+    fprintf(file, "P6\n%d %d\n255\n", DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    for (int row = 0; row < DISPLAY_HEIGHT; row++)
+      for (int col = 0; col < DISPLAY_WIDTH; col++)
+      {
+        byte rgb[3] = {0xFF, 0xFF, 0xFF};
+        switch (Pixel(row, col))
+        {
+          case Display::ColourRed: rgb[1] = rgb[2] = 0x00; break;
+          case Display::MonoBlack: rgb[0] = rgb[1] = rgb[2] = 0x00; break;
+          case Display::MonoGrey:  rgb[0] = rgb[1] = rgb[2] = 0x80; break;
+          default: break;
+        }
+        fwrite(rgb, 1, sizeof(rgb), file);
+      }
+    fclose(file);
+  }
+
+  double ModelMicros()
+  {
+    // the board's time for what it's done to the panel, the delays (BUSY waits too) as they're called, plus
+    // the SPI bytes at 2MHz with the loop around SPDR (~16 cycles at 16MHz), and Pins.h's port writes (2 cycles)
+    return microsNow + 5.0*spiBytes + 0.125*pinWrites;
+  }
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+  // the controller, just the commands which matter here. DC low is a command
+  using namespace Host;
+  spiBytes++;
+  if (microsNow < busyUntil)
+    busyBytes++;
+  int first = partialIn ? windowFirst : 0, rows = partialIn ? windowLast - windowFirst + 1 : DISPLAY_HEIGHT;
+  if (!pinValues[PIN_DISPLAY_DC])
+  {
+    command = data;
+    param = 0;
+    registers[command] = 0;
+    plane = nullptr;
+    if (data == 0x10)
+      StartPlane(&mono[first][0], rows*sizeof(mono[0]));
+    else if (data == 0x13)
+      StartPlane(&red[first][0], rows*sizeof(red[0]));
+    else if (data == 0x12)
+    {
+      if (imagePrefix)
+      {
+        char path[256];
+        snprintf(path, sizeof(path), "%s%d.ppm", imagePrefix, frames);
+        WriteImage(path);
+      }
+      frames++;
+      rowsRefreshed += rows;
+      busyUntil = microsNow + RefreshMicros();
+    }
+    else if (data == 0x02)
+      asleep = true;
+    else if (data == 0x04)
+      asleep = false;
+    else if (data == 0x91)
+      partialIn = true;
+    else if (data == 0x92)
+      partialIn = false;
+  }
+  else if (plane && planePos < planeSize)
+    plane[planePos++] = data;
+  else
+  {
+    registers[command] = 31*registers[command] + data + 1;
+    if (command >= 0x20 && command <= 0x27 && param < 15)
+      luts[command - 0x20][param] = data;
+    if (command == 0x90 && param >= 2 && param <= 5) // partial window, cols (ignored, the whole width is used), then rows
+    {
+      int& row = (param < 4) ? windowFirst : windowLast;
+      row = (param & 1) ? (row | data) : (data << 8);
+    }
+    param++;
+  }
+  return 0;
+}
+
+long random(long from, long to) { return from + rand() % (to - from); }
+void randomSeed(unsigned long seed) { srand(seed); }
+void delay(unsigned long ms)
+{
+  if (Host::microsNow < Host::busyUntil)
+    Host::busyMicros += min(1000*ms, Host::busyUntil - Host::microsNow);
+  Host::microsNow += 1000*ms;
+}
+void delayMicroseconds(unsigned int us) { Host::microsNow += us; }
+unsigned long millis() { return Host::microsNow/1000; }
+unsigned long micros() { return Host::microsNow; }
+void pinMode(int, int) {}
+void digitalWrite(int pin, int value)
+{
+  Host::pinValues[pin] = value;
+  Host::pinWrites++;
+  if (pin == PIN_DISPLAY_RST && !value)
+  {
+    // reset
+    Host::partialIn = false;
+    ::memset(Host::registers, 0, sizeof(Host::registers));
+    ::memset(Host::luts, 0, sizeof(Host::luts));
+  }
+}
+int digitalRead(int pin) { return (pin == PIN_DISPLAY_BUSY && Host::microsNow < Host::busyUntil) ? LOW : HIGH; }
@@ -0,0 +1,41 @@
+#pragma once
+// Host (PC) build support, see readme.txt
+#include "Display.h"
+
+namespace Host
+{
+  // the virtual panel, filled by what the sketch sends, each plane from row 0 (or the partial window's first) after its data start command
+  extern byte mono[DISPLAY_HEIGHT][DISPLAY_WIDTH/4];
+  extern byte red[DISPLAY_HEIGHT][DISPLAY_WIDTH/8];
+  extern int frames;             // refreshes
+  extern unsigned long spiBytes; // commands & data
+  // BUSY is held low (busy) for this long after a refresh command, with the panel's own LUTs, in proportion to the
+  // frames in the LUTs sent, time only passes in delays
+#define REFRESH_MICROS 15000000UL
+  extern unsigned long busyBytes; // sent while busy, the panel would ignore them
+  extern bool asleep;             // powered off, until powered on
+  extern bool partialIn;          // in partial mode, the planes & refresh are just the window's rows
+  extern unsigned long rowsRefreshed;
+  extern uint16_t registers[256]; // a hash of the data last sent with each command, cleared by a reset, kept while powered off
+  void ClearPanel();
+  Display::Colour Pixel(int row, int col);
+  void WriteImage(const char* path); // PPM
+  extern const char* imagePrefix;    // if set, each frame's written to <imagePrefix><frames>.ppm as it's refreshed
+  // the time the board would take for what it sent, see host.cpp, not counting the drawing
+  extern unsigned long pinWrites, busyMicros; // busyMicros, of the delays, waiting for BUSY
+  double ModelMicros();
+
+  // the calls made to SparseInk, recorded by recorder.cpp for replaying
+  enum OpKind {OpClear, OpPixel, OpSpan, OpInk, OpSend, OpRetain, OpRelease, OpErase};
+  struct Op
+  {
+    byte kind;
+    uint16_t row, col, len; // OpClear row, OpInk col = ink, OpSend & OpRetain row..col
+    byte foreground, background; // OpSend
+    uint16_t last; // OpErase rows row..last, cols col..col+len-1
+  };
+  extern Op* ops;
+  extern int numOps, maxOps;
+  void StartRecording(Op* buffer, int size);
+  void Record(byte kind, uint16_t row, uint16_t col, uint16_t len = 0, byte foreground = 0, byte background = 0, uint16_t last = 0);
+}
@@ -0,0 +1,65 @@
+// Runs the sketch's drawing (Page, StrokedFont, Graphics & SparseInk itself) and Display against host.cpp's panel, writing
+// each frame refreshed as a PPM and printing the time the board would take to send & refresh it, see readme.txt
+#include <chrono>
+#include <Arduino.h>
+#include "Display.h"
+#include "SparseInk.h"
+#include "Page.h"
+#include "host.h"
+
+namespace Page
+{
+  void Paint(int pressure_hPa, char forecastLetter, char pressureTrend, int temperature_C, int humidity_Percent);
+}
+
+struct Snapshot
+{
+  double modelMicros;
+  unsigned long micros, busyMicros, spiBytes, pinWrites;
+  std::chrono::steady_clock::time_point start;
+};
+
+void Start(Snapshot& snapshot)
+{
+  snapshot = {Host::ModelMicros(), micros(), Host::busyMicros, Host::spiBytes, Host::pinWrites, std::chrono::steady_clock::now()};
+}
+
+void Report(const char* name, const Snapshot& start)
+{
+  // from Start, the counts & the board's time, and the PC's for comparison
+  double pc = std::chrono::duration<double>(std::chrono::steady_clock::now() - start.start).count();
+  unsigned long delays = micros() - start.micros, busy = Host::busyMicros - start.busyMicros;
+  printf("%-10s %6d %7lu %7lu %9.1f %9.1f %9.1f %9.1f\n", name, Host::frames - 1, Host::spiBytes - start.spiBytes,
+         Host::pinWrites - start.pinWrites, (delays - busy)/1e3, busy/1e3, (Host::ModelMicros() - start.modelMicros)/1e3, 1e3*pc);
+}
+
+int main(int argc, char** argv)
+{
+  Host::imagePrefix = (argc > 1) ? argv[1] : "frame";
+  Host::ClearPanel();
+  printf("%-10s %6s %7s %7s %9s %9s %9s %9s\n", "page", "frame", "spi", "pins", "delay ms", "busy ms", "board ms", "pc ms");
+#if DISPLAY_WIDTH == 200 && DISPLAY_HEIGHT == 200
+  // as setup() does, then pages as Page::Loop does, woken, drawn & sent, refreshed, then asleep
+  Snapshot snapshot;
+  Start(snapshot);
+  Page::Init();
+  Page::Splash();
+  Display::Sleep();
+  Report("splash", snapshot);
+  const char letters[] = {'A', 'F', 'K', 'P', 'U', 'Z', '?'};
+  const char trends[] = {'S', 'R', 'F', 'S', 'R', 'F', '?'};
+  for (int i = 0; i < 7; i++)
+  {
+    Start(snapshot);
+    Display::Init();
+    Page::Paint(990 + i*7, letters[i], trends[i], -5 + i*7, (i == 6) ? -1 : 30 + i*11);
+    Display::Sleep();
+    char name[16];
+    sprintf(name, "page %d", i);
+    Report(name, snapshot);
+  }
+#else
+  printf("Page's layout is for 200x200\n");
+#endif
+  return SparseInk::error ? 1 : 0;
+}
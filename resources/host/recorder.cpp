@@ -0,0 +1,107 @@
+// Stands in for SparseInk, recording the calls made to it for bench.cpp to replay
+// built with SparseInk defined as Recorder, as are the sources which draw, see build.sh
+#include <Arduino.h>
+#include "Display.h"
+#include "SparseInk.h"
+#include "host.h"
+
+namespace Host
+{
+  Op* ops = nullptr;
+  int numOps = 0, maxOps = 0;
+
+  void StartRecording(Op* buffer, int size)
+  {
+    ops = buffer;
+    maxOps = size;
+    numOps = 0;
+  }
+
+  void Record(byte kind, uint16_t row, uint16_t col, uint16_t len, byte foreground, byte background, uint16_t last)
+  {
+    if (numOps < maxOps)
+      ops[numOps] = {kind, row, col, len, foreground, background, last};
+    numOps++;
+  }
+}
+
+namespace SparseInk
+{
+  // never full
+  int tableHighWater = 0;
+  Error error = eNone;
+#ifdef SPARSEINK_STATS
+  Stats stats;
+#endif
+
+  bool red = false; // InkRed since the page's first Clear, a guess at what SparseInk would keep
+
+  void Clear(Coord firstRow)
+  {
+    Host::Record(Host::OpClear, firstRow, 0);
+    if (!firstRow)
+      red = false;
+  }
+
+  bool HasRed()
+  {
+    return red;
+  }
+
+  void Dump()
+  {
+  }
+
+  void Pixel(Coord row, Coord col)
+  {
+    Host::Record(Host::OpPixel, row, col, 1);
+  }
+
+  void Span(Coord row, Coord col, Coord len)
+  {
+    Host::Record(Host::OpSpan, row, col, len);
+  }
+
+  void SetInk(Ink ink)
+  {
+    Host::Record(Host::OpInk, 0, ink);
+    red |= (ink == InkRed);
+  }
+
+  void Flush()
+  {
+    // nothing logged, the pixels are recorded as they come
+  }
+
+  void Retain(Coord firstRow, Coord lastRow)
+  {
+    Host::Record(Host::OpRetain, firstRow, lastRow);
+  }
+
+  void Release()
+  {
+    Host::Record(Host::OpRelease, 0, 0);
+  }
+
+  void EraseRect(Coord firstRow, Coord lastRow, Coord firstCol, Coord lastCol)
+  {
+    Host::Record(Host::OpErase, firstRow, firstCol, lastCol - firstCol + 1, 0, 0, lastRow);
+  }
+
+  void SendRows(Coord firstRow, Coord lastRow, Display::Colour foreground, Display::Colour background)
+  {
+    Host::Record(Host::OpSend, firstRow, lastRow, 0, foreground, background);
+  }
+
+  void Render(Coord firstRow, Coord lastRow, Display::Colour foreground, Display::Colour background, DrawCallback draw)
+  {
+    Clear(firstRow);
+    draw();
+    SendRows(firstRow, lastRow, foreground, background);
+  }
+
+  void Paint()
+  {
+    SendRows(0, DISPLAY_HEIGHT - 1, Display::MonoBlack, Display::MonoWhite);
+  }
+}